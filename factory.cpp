@@ -1,7 +1,17 @@
 #include <memory>
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 // Base class
 class Vehicle {
@@ -10,45 +20,257 @@ public:
     virtual void drive() = 0;
 };
 
+// runs the destructor only, the memory belongs to an arena
+struct destroy_only {
+    void operator()(Vehicle* v) const { v->~Vehicle(); }
+};
+using arena_ptr = std::unique_ptr<Vehicle, destroy_only>;
+
+// objects of one concrete type stored contiguously. hooks are called once per group through the vtable and
+// dispatch statically inside it
+class vehicle_group_base {
+public:
+    virtual ~vehicle_group_base() = default;
+    virtual size_t size() const = 0;
+    // the reference is invalidated by the next append, which may move every object of the group
+    virtual Vehicle& operator[](size_t i) = 0;
+    virtual void append(std::span<const std::string_view> descs) = 0;
+    virtual void drive_all() = 0;
+};
+
+template <typename T>
+class vehicle_group final : public vehicle_group_base {
+public:
+    size_t size() const override { return items_.size(); }
+    Vehicle& operator[](size_t i) override { return items_[i]; }
+    void append(std::span<const std::string_view> descs) override {
+        items_.reserve(items_.size() + descs.size());
+        for (auto desc : descs)
+            items_.emplace_back(desc);
+    }
+    void drive_all() override {
+        for (auto& v : items_)
+            v.T::drive();  // qualified, no vtable lookup per object
+    }
+
+private:
+    std::vector<T> items_;
+};
+
 // Factory
 class VehicleFactory {
+public:
+    using type_id = uint32_t;  // index into the registry, stable for the lifetime of the process
+
 private:
-    using vehicle_ctor_fn = std::function<std::unique_ptr<Vehicle>(const std::string&)>;
-    using map_t = std::unordered_map<std::string, vehicle_ctor_fn>;
+    // plain function pointers, no std::function
+    using vehicle_ctor_fn = std::unique_ptr<Vehicle> (*)(std::string_view);
+    using vehicle_place_fn = Vehicle* (*)(void* mem, std::string_view);
+    using vehicle_group_fn = std::unique_ptr<vehicle_group_base> (*)();
+    struct entry {
+        vehicle_ctor_fn create;
+        vehicle_place_fn place;  // construct into caller-provided memory of at least size bytes aligned to align
+        size_t size;
+        size_t align;
+        vehicle_group_fn make_group;  // nullptr for types that can't be grouped
+    };
+
+    // transparent hash, so char* and string_view lookups don't build a temporary std::string
+    struct string_hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+    using map_t = std::unordered_map<std::string, type_id, string_hash, std::equal_to<>>;
     static map_t& get_map() {
-        static map_t create_fn_map;
-        return create_fn_map;
+        static map_t type_id_map;
+        return type_id_map;
     }
-    static void add_create_fn(const std::string& type, vehicle_ctor_fn fn) {
+    static std::vector<entry>& get_entries() {
+        static std::vector<entry> entries;
+        return entries;
+    }
+    static type_id add_create_fn(std::string_view type, entry e) {
         auto& m = get_map();
+        auto& entries = get_entries();
 
-        if (const auto& ret = m.emplace(type, fn); !ret.second) {
-            throw std::runtime_error(std::string("Fail to register type: ") + type);
+        if (const auto& ret = m.emplace(type, static_cast<type_id>(entries.size())); !ret.second) {
+            throw std::runtime_error(std::string("Fail to register type: ") + std::string(type));
         }
+        entries.push_back(e);
+        return static_cast<type_id>(entries.size() - 1);
     }
+    static const entry& get_entry(type_id id) {
+        auto& entries = get_entries();
+        if (id >= entries.size()) {
+            throw std::runtime_error("Invalid vehicle type id");
+        }
+        return entries[id];
+    }
+
+    template <typename T>
+    static std::unique_ptr<Vehicle> create(std::string_view desc) {
+        return std::make_unique<T>(desc);
+    }
+    template <typename T>
+    static Vehicle* place(void* mem, std::string_view desc) {
+        return new (mem) T(desc);
+    }
+    template <typename T>
+    static std::unique_ptr<vehicle_group_base> make_group() {
+        return std::make_unique<vehicle_group<T>>();
+    }
+    // a group stores its objects in a vector, which needs T movable. other types can still be registered and
+    // created one by one, vehicle_group<T> is only instantiated when it can be
+    template <typename T>
+    static constexpr vehicle_group_fn group_maker() {
+        if constexpr (std::is_move_constructible_v<T>)
+            return &make_group<T>;
+        else
+            return nullptr;
+    }
+
 public:
+    template <typename T>
     struct add_type {
-        add_type(const std::string& type, vehicle_ctor_fn fn) {
-            add_create_fn(type, fn);
-        }
+        explicit add_type(std::string_view type) : id(add_create_fn(type, entry{ &create<T>, &place<T>, sizeof(T), alignof(T), group_maker<T>() })) {}
+        const type_id id;
     };
-    
-    static std::unique_ptr<Vehicle> createVehicle(const std::string& type, const std::string& desc) {
-        auto& vehicles = get_map();
-        auto it = vehicles.find(type);
-        if (it == vehicles.end()) {
+
+    // resolve once, then create by id to skip the hash lookup
+    static type_id find_type(std::string_view type) {
+        auto& m = get_map();
+        auto it = m.find(type);
+        if (it == m.end()) {
             throw std::runtime_error("Invalid vehicle type");
         }
-        auto& fn = it->second;
-        return fn(desc);
+        return it->second;
+    }
+
+    static std::unique_ptr<Vehicle> createVehicle(std::string_view type, std::string_view desc) {
+        return createVehicle(find_type(type), desc);
+    }
+
+    static std::unique_ptr<Vehicle> createVehicle(type_id id, std::string_view desc) {
+        return get_entry(id).create(desc);
+    }
+
+    // construct into memory from arena.allocate(size, align) instead of the heap. the arena owns the memory,
+    // the returned pointer only runs the destructor
+    template <typename Arena>
+    static arena_ptr createVehicle(type_id id, std::string_view desc, Arena& arena) {
+        auto& e = get_entry(id);
+        return arena_ptr(e.place(arena.allocate(e.size, e.align), desc));
+    }
+
+    // one type lookup for the whole batch, the objects are constructed contiguously
+    static std::unique_ptr<vehicle_group_base> createMany(std::string_view type, std::span<const std::string_view> descs) {
+        return createMany(find_type(type), descs);
+    }
+
+    static std::unique_ptr<vehicle_group_base> createMany(type_id id, std::span<const std::string_view> descs) {
+        auto group = newGroup(id);
+        group->append(descs);
+        return group;
+    }
+
+    static std::unique_ptr<vehicle_group_base> newGroup(type_id id) {
+        auto& e = get_entry(id);
+        if (!e.make_group) {
+            throw std::runtime_error("Vehicle type is not movable and can't be grouped");
+        }
+        return e.make_group();
     }
 };
 
+// vehicles kept grouped by registered type, so a pass over all of them makes one virtual call per type
+class vehicle_fleet {
+public:
+    void createMany(std::string_view type, std::span<const std::string_view> descs) {
+        group(VehicleFactory::find_type(type)).append(descs);
+    }
+
+    void createMany(VehicleFactory::type_id id, std::span<const std::string_view> descs) {
+        group(id).append(descs);
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (auto& g : groups_)
+            n += g ? g->size() : 0;
+        return n;
+    }
+
+    void drive_all() {
+        for (auto& g : groups_)
+            if (g)
+                g->drive_all();
+    }
+
+private:
+    vehicle_group_base& group(VehicleFactory::type_id id) {
+        if (id >= groups_.size())
+            groups_.resize(id + 1);
+        if (!groups_[id])
+            groups_[id] = VehicleFactory::newGroup(id);
+        return *groups_[id];
+    }
+
+    std::vector<std::unique_ptr<vehicle_group_base>> groups_;  // indexed by type id
+};
+
+// bump allocator for short-lived objects, everything is released at once by reset() or the destructor
+class vehicle_arena {
+public:
+    explicit vehicle_arena(size_t block_size = 64 * 1024) : block_size_(block_size) {}
+    vehicle_arena(const vehicle_arena&) = delete;
+    vehicle_arena& operator=(const vehicle_arena&) = delete;
+    ~vehicle_arena() {
+        for (auto* b : blocks_)
+            std::free(b);
+    }
+
+    void* allocate(size_t sz, size_t align) {
+        if (sz > block_size_)
+            throw std::bad_alloc();
+        auto offset = (used_ + align - 1) / align * align;
+        if (cur_ == blocks_.size() || offset + sz > block_size_) {
+            next_block();
+            offset = 0;
+        }
+        used_ = offset + sz;
+        return blocks_[cur_] + offset;
+    }
+
+    // all objects must have been destroyed, the blocks are kept for reuse
+    void reset() {
+        cur_ = 0;
+        used_ = 0;
+    }
+
+private:
+    void next_block() {
+        if (cur_ + 1 < blocks_.size()) {
+            ++cur_;
+            return;
+        }
+        auto* b = static_cast<std::byte*>(std::aligned_alloc(alignof(std::max_align_t), block_size_));
+        if (!b)
+            throw std::bad_alloc();
+        blocks_.push_back(b);
+        cur_ = blocks_.size() - 1;
+    }
+
+    size_t block_size_;
+    std::vector<std::byte*> blocks_;
+    size_t cur_{};   // current block, == blocks_.size() only before the first allocation
+    size_t used_{};
+};
+
 // Derived classes
-class Car : public Vehicle {
-    static inline VehicleFactory::add_type reg{"Car", [](const std::string& desc) { return std::make_unique<Car>(desc); }};
+class Car final : public Vehicle {
+    static inline VehicleFactory::add_type<Car> reg{"Car"};
 public:
-    Car(const std::string& desc) {
+    Car(std::string_view desc) {
         std::cout << "Creating a car with description: " << desc << '\n';
     }
     void drive() override {
@@ -56,10 +278,10 @@ public:
     }
 };
 
-class Bike : public Vehicle {
-    static inline VehicleFactory::add_type reg{"Bike", [](const std::string& desc) { return std::make_unique<Bike>(desc); }};
+class Bike final : public Vehicle {
+    static inline VehicleFactory::add_type<Bike> reg{"Bike"};
 public:
-    Bike(const std::string& desc) {
+    Bike(std::string_view desc) {
         std::cout << "Creating a bike with description: " << desc << '\n';
     }
     void drive() override {
@@ -75,5 +297,26 @@ int main() {
     auto bike = VehicleFactory::createVehicle("Bike", "red");
     bike->drive(); // Prints "Riding a bike"
 
+    // repeated creates: resolve the type once, then no hashing and no heap
+    auto bike_id = VehicleFactory::find_type(std::string_view("Bike"));
+    vehicle_arena arena;
+    for (int i = 0; i < 2; ++i) {
+        auto v = VehicleFactory::createVehicle(bike_id, "green", arena);
+        v->drive();
+    }
+    arena.reset();
+
+    // bulk creation, driven type by type
+    const std::string_view descs[] = { "black", "white", "silver" };
+    auto cars = VehicleFactory::createMany("Car", descs);
+    (*cars)[1].drive();
+
+    vehicle_fleet fleet;
+    fleet.createMany("Car", descs);
+    fleet.createMany(bike_id, std::span(descs).first(2));
+    fleet.createMany("Car", std::span(descs).last(1));
+    std::cout << "fleet of " << fleet.size() << '\n';
+    fleet.drive_all();
+
     return 0;
 }
@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "command.hpp"
+#include "orderbook.hpp"
+
+namespace orderbook {
+
+// fixed-width binary form of the text commands, with the fields and codes of
+// shm_command and checked by the same check_command. every message is
+// BIN_MSG_SIZE bytes, all integers little-endian, prices in fixed point
+// units of 1 / PRC_MULTIPLIER:
+//
+//   offset  size  field
+//        0     1  type, command::type_t: ADD, CXL, PRINT or MASS_CXL
+//        1     1  side, side_t: 0 buy, 1 sell, 2 both (M only)
+//        2     2  qty
+//        4     4  oid
+//        8     8  sym, '\0' padded
+//       16     8  prc, the low end of the range for M
+//       24     8  prc_hi, M only
+//
+// fields an action does not use are written as 0 and ignored when read
+static constexpr size_t BIN_MSG_SIZE = 32;
+
+namespace bin {
+
+template <typename T>
+inline T load_le(const unsigned char* p) {
+    T v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        v |= static_cast<T>(static_cast<T>(p[i]) << (8 * i));
+    return v;
+}
+
+template <typename T>
+inline void store_le(unsigned char* p, T v) {
+    for (size_t i = 0; i < sizeof(T); ++i)
+        p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+}  // namespace bin
+
+// writes cmd to out[0, BIN_MSG_SIZE). only ADD, CXL, MASS_CXL and PRINT have
+// a binary form, returns false for anything else
+inline bool encode_command(const command& cmd, char* out) {
+    auto* p = reinterpret_cast<unsigned char*>(out);
+    std::fill_n(p, BIN_MSG_SIZE, 0);
+    switch (cmd.type) {
+        case command::ADD:
+        case command::CXL:
+        case command::MASS_CXL:
+        case command::PRINT:
+            p[0] = cmd.type;
+            break;
+        default:
+            return false;
+    }
+    p[1] = static_cast<unsigned char>(cmd.side);
+    bin::store_le<uint16_t>(p + 2, cmd.qty);
+    bin::store_le<uint32_t>(p + 4, cmd.oid);
+    std::copy_n(cmd.sym.begin(), cmd.sym.size(), p + 8);
+    bin::store_le<uint64_t>(p + 16, cmd.prc);
+    bin::store_le<uint64_t>(p + 24, cmd.prc_hi);
+    return true;
+}
+
+// reads the message at in[0, BIN_MSG_SIZE)
+inline command decode_command(const char* in) {
+    auto* p = reinterpret_cast<const unsigned char*>(in);
+    sym_t sym;
+    std::copy_n(p + 8, sym.size(), sym.begin());
+    return check_command(p[0], p[1], bin::load_le<uint16_t>(p + 2),
+        bin::load_le<uint32_t>(p + 4), sym, bin::load_le<uint64_t>(p + 16),
+        bin::load_le<uint64_t>(p + 24));
+}
+
+// the text line parse_command reads back into cmd, empty if cmd has no text
+// form (a MASS_CXL with a price range on both sides or from 0). prices are
+// written as exact decimals of the fixed point value
+inline std::string format_command(const command& cmd) {
+    std::string line;
+    auto side = [](side_t s) { return s == BUY ? " B" : " S"; };
+    switch (cmd.type) {
+        case command::ADD:
+            line = "O " + std::to_string(cmd.oid) + " " + to_string(cmd.sym) +
+                   side(cmd.side) + " " + std::to_string(cmd.qty) + " ";
+            append_prc(line, cmd.prc);
+            break;
+        case command::CXL:
+            line = "X " + std::to_string(cmd.oid);
+            break;
+        case command::MASS_CXL: {
+            bool ranged = cmd.prc != 0 ||
+                          cmd.prc_hi != std::numeric_limits<price_t>::max();
+            if (ranged && (cmd.side == UNKNOWN || cmd.prc == 0))
+                break;
+            line = "M " + to_string(cmd.sym);
+            if (cmd.side != UNKNOWN)
+                line += side(cmd.side);
+            if (ranged) {
+                line += " ";
+                append_prc(line, cmd.prc);
+                line += " ";
+                append_prc(line, cmd.prc_hi);
+            }
+            break;
+        }
+        case command::PRINT:
+            line = "P";
+            break;
+        default:
+            break;
+    }
+    return line;
+}
+
+// feeds the messages of a binary stream straight to an OrderBookMgr, with no
+// tokenizing on the way
+class binary_dispatcher {
+ public:
+    explicit binary_dispatcher(OrderBookMgr& obm) : obm_(obm) {}
+
+    // executes every whole message in data[0, n) and calls done() after
+    // each. returns the bytes consumed, a trailing partial message is left
+    template <typename Done>
+    size_t feed(const char* data, size_t n, Done&& done) {
+        size_t used = 0;
+        for (; n - used >= BIN_MSG_SIZE; used += BIN_MSG_SIZE) {
+            obm_.execute(decode_command(data + used));
+            done();
+        }
+        return used;
+    }
+
+    // runs the messages of in until EOF, returns false if it ended inside
+    // a message
+    template <typename Done>
+    bool run(std::istream& in, Done&& done) {
+        std::vector<char> buf(BIN_MSG_SIZE * 2048);
+        size_t have = 0;
+        while (in) {
+            in.read(buf.data() + have,
+                static_cast<std::streamsize>(buf.size() - have));
+            have += static_cast<size_t>(in.gcount());
+            size_t used = feed(buf.data(), have, done);
+            std::copy(buf.begin() + used, buf.begin() + have, buf.begin());
+            have -= used;
+        }
+        return have == 0;
+    }
+
+ private:
+    OrderBookMgr& obm_;
+};
+
+}  // namespace orderbook
@@ -0,0 +1,66 @@
+#pragma once
+#include <utility>
+#include <vector>
+
+#include "defs.hpp"
+
+namespace orderbook {
+
+// aggregated quantity of one price level, qty 0 means the level is gone
+struct level_update {
+    side_t side{};
+    price_t prc{};
+    uint32_t qty{};
+};
+
+// the order of book_delta::levels, bids first then asks, each by price
+inline bool level_before(const level_update& a, const level_update& b) {
+    return a.side != b.side ? a.side < b.side : a.prc < b.prc;
+}
+
+// what changed in one book. successive deltas of the same book merge into
+// one that takes the book from the state before the first to the state after
+// the last
+struct book_delta {
+    sym_t sym{};
+    price_t bid_prc{};  // 0 when the side is empty
+    uint32_t bid_qty{};
+    price_t ask_prc{};
+    uint32_t ask_qty{};
+    std::vector<level_update> levels;  // at most one entry per side and
+                                       // price, sorted by level_before
+    uint32_t commands{1};              // number of commands folded in
+
+    void merge(book_delta d) {
+        bid_prc = d.bid_prc;
+        bid_qty = d.bid_qty;
+        ask_prc = d.ask_prc;
+        ask_qty = d.ask_qty;
+        commands += d.commands;
+        if (d.levels.empty())
+            return;
+        if (levels.empty()) {
+            levels = std::move(d.levels);
+            return;
+        }
+        // one pass over both sorted lists, the later qty wins for a level in
+        // both
+        std::vector<level_update> out;
+        out.reserve(levels.size() + d.levels.size());
+        auto a = levels.begin(), b = d.levels.begin();
+        while (a != levels.end() && b != d.levels.end()) {
+            if (level_before(*a, *b)) {
+                out.push_back(*a++);
+            } else {
+                if (!level_before(*b, *a))
+                    ++a;
+                out.push_back(*b++);
+            }
+        }
+        out.insert(out.end(), a, levels.end());
+        out.insert(out.end(), b, d.levels.end());
+        levels = std::move(out);
+    }
+};
+
+}  // namespace orderbook
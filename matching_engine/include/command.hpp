@@ -0,0 +1,181 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "defs.hpp"
+#include "utils.hpp"
+
+namespace orderbook {
+
+// one parsed input line. fixed size so it can be passed between threads by
+// value, the error text is only allocated on the error path
+struct command {
+    enum type_t : uint8_t { NONE, ADD, CXL, PRINT, ERR, END, MASS_CXL };
+    type_t type{NONE};
+    side_t side{UNKNOWN};
+    qty_t qty{};
+    uint32_t oid{};
+    sym_t sym{};
+    price_t prc{};
+    price_t prc_hi{};  // MASS_CXL only, prc is the low end of the range
+    std::unique_ptr<std::string> err;
+};
+
+inline auto split_str_by_delim(const std::string& str, const char delim) {
+    std::vector<std::string> result;
+    size_t start = 0;
+    auto end = str.find(delim);
+    while (end != std::string::npos) {
+        result.push_back(str.substr(start, end - start));
+        start = end + 1;
+        end = str.find(delim, start);
+    }
+    result.push_back(str.substr(start));
+    return result;
+}
+
+// text price to fixed point. rounded, not truncated: most decimals have no
+// exact double, and 0.00015 * PRC_MULTIPLIER is 14.999..., which must read
+// back as the 15 it was written from
+inline price_t to_fixed_prc(double prc) {
+    return static_cast<price_t>(std::llround(prc * PRC_MULTIPLIER));
+}
+
+inline command make_err(std::string msg) {
+    command cmd;
+    cmd.type = command::ERR;
+    cmd.err = std::make_unique<std::string>(std::move(msg));
+    return cmd;
+}
+
+// builds a command from the fields of a binary request (shm_command or a
+// binary_protocol message). they are typed already, so only the checks of
+// parse_command on their values are left
+inline command check_command(uint8_t type, uint8_t side, qty_t qty,
+    uint32_t oid, const sym_t& sym, price_t prc, price_t prc_hi) {
+    command cmd;
+    switch (type) {
+        case command::ADD:
+            if (side != BUY && side != SELL)
+                return make_err(std::to_string(oid) + " Invalid side: " +
+                                std::to_string(side));
+            if (qty == 0)
+                return make_err(std::to_string(oid) + " Invalid qty: 0");
+            if (prc == 0)
+                return make_err(std::to_string(oid) + " Invalid prc: 0");
+            cmd.type = command::ADD;
+            cmd.oid = oid;
+            cmd.sym = sym;
+            cmd.side = static_cast<side_t>(side);
+            cmd.qty = qty;
+            cmd.prc = prc;
+            return cmd;
+        case command::CXL:
+            cmd.type = command::CXL;
+            cmd.oid = oid;
+            return cmd;
+        case command::MASS_CXL:
+            if (side > UNKNOWN)
+                return make_err(to_string(sym) + " Invalid side: " +
+                                std::to_string(side));
+            if (prc_hi < prc)
+                return make_err(to_string(sym) + " Invalid prc: " +
+                                std::to_string(prc_hi));
+            cmd.type = command::MASS_CXL;
+            cmd.sym = sym;
+            cmd.side = static_cast<side_t>(side);
+            cmd.prc = prc;
+            cmd.prc_hi = prc_hi;
+            return cmd;
+        case command::PRINT:
+            cmd.type = command::PRINT;
+            return cmd;
+        default:
+            return make_err(std::to_string(type) + " Invalid action");
+    }
+}
+
+inline command parse_command(const std::string& line) {
+    auto tokens = split_str_by_delim(line, ' ');
+    if (tokens.empty())
+        return {};
+    auto arg = [&tokens](size_t i) {
+        return i < tokens.size() ? tokens[i] : std::string();
+    };
+    command cmd;
+    if (tokens[0] == "O") {
+        if (tokens.size() != 6) {
+            return make_err(arg(1) + " Invalid number of arguments");
+        }
+        auto side = tokens[3] == "B" ? side_t::BUY
+                                     : (tokens[3] == "S" ? side_t::SELL
+                                                         : side_t::UNKNOWN);
+        if (side == UNKNOWN) {
+            return make_err(tokens[1] + " Invalid side: " + tokens[3]);
+        }
+        int32_t qty{};
+        if (!convert_to_int(tokens[4], qty) || qty <= 0) {
+            return make_err(tokens[1] + " Invalid qty: " + tokens[4]);
+        }
+        double prc{};
+        if (!convert_to_double(tokens[5], prc) || prc <= 0) {
+            return make_err(tokens[1] + " Invalid prc: " + tokens[5]);
+        }
+
+        cmd.type = command::ADD;
+        cmd.oid = static_cast<uint32_t>(std::stoi(tokens[1]));
+        cmd.sym.fill(0);
+        std::copy_n(tokens[2].begin(),
+            std::min(tokens[2].size(), cmd.sym.size()), cmd.sym.begin());
+        cmd.side = side;
+        cmd.qty = static_cast<qty_t>(qty);
+        cmd.prc = to_fixed_prc(prc);
+    } else if (tokens[0] == "X") {
+        if (tokens.size() != 2) {
+            return make_err(arg(1) + " Invalid number of arguments");
+        }
+        cmd.type = command::CXL;
+        cmd.oid = static_cast<uint32_t>(std::stoi(tokens[1]));
+    } else if (tokens[0] == "M") {
+        // M sym [B|S [lo hi]]
+        if (tokens.size() != 2 && tokens.size() != 3 && tokens.size() != 5) {
+            return make_err(arg(1) + " Invalid number of arguments");
+        }
+        cmd.type = command::MASS_CXL;
+        cmd.sym.fill(0);
+        std::copy_n(tokens[1].begin(),
+            std::min(tokens[1].size(), cmd.sym.size()), cmd.sym.begin());
+        cmd.prc = 0;
+        cmd.prc_hi = std::numeric_limits<price_t>::max();
+        if (tokens.size() >= 3) {
+            cmd.side = tokens[2] == "B" ? side_t::BUY
+                                        : (tokens[2] == "S" ? side_t::SELL
+                                                            : side_t::UNKNOWN);
+            if (cmd.side == UNKNOWN) {
+                return make_err(tokens[1] + " Invalid side: " + tokens[2]);
+            }
+        }
+        if (tokens.size() == 5) {
+            double lo{}, hi{};
+            if (!convert_to_double(tokens[3], lo) || lo <= 0) {
+                return make_err(tokens[1] + " Invalid prc: " + tokens[3]);
+            }
+            if (!convert_to_double(tokens[4], hi) || hi < lo) {
+                return make_err(tokens[1] + " Invalid prc: " + tokens[4]);
+            }
+            cmd.prc = to_fixed_prc(lo);
+            cmd.prc_hi = to_fixed_prc(hi);
+        }
+    } else if (tokens[0] == "P") {
+        cmd.type = command::PRINT;
+    } else {
+        return make_err(tokens[0] + " Invalid action");
+    }
+    return cmd;
+}
+
+}  // namespace orderbook
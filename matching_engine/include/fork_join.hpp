@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.hpp"
+
+namespace orderbook {
+
+// runs fn(ctx, i) for every i in [0, n) on a fixed set of helper threads and
+// the calling thread, and returns once all of them are done. one caller at a
+// time
+class fork_join {
+ public:
+    using task_fn = void (*)(void* ctx, size_t i);
+
+    explicit fork_join(size_t helpers) {
+        for (size_t i = 0; i < helpers; ++i)
+            threads_.emplace_back([this]() { helper_loop(); });
+    }
+    fork_join(const fork_join&) = delete;
+    fork_join& operator=(const fork_join&) = delete;
+    ~fork_join() {
+        {
+            std::lock_guard lk(lock_);
+            shutdown_ = true;
+        }
+        cond_.notify_all();
+        for (auto& t : threads_)
+            t.join();
+    }
+
+    size_t helpers() const { return threads_.size(); }
+
+    void run(size_t n, task_fn fn, void* ctx) {
+        if (threads_.empty() || n < 2) {
+            for (size_t i = 0; i < n; ++i)
+                fn(ctx, i);
+            return;
+        }
+        {
+            std::lock_guard lk(lock_);
+            // a helper still inside the previous run would take indices of
+            // this one, wait until they all left
+            spin_until(
+                [this]() { return active_.load(std::memory_order_acquire) == 0; });
+            job_ = {fn, ctx, n};
+            next_.store(0, std::memory_order_relaxed);
+            done_.store(0, std::memory_order_relaxed);
+            ++generation_;
+        }
+        cond_.notify_all();
+        work(job_);
+        spin_until(
+            [&]() { return done_.load(std::memory_order_acquire) == n; });
+    }
+
+ private:
+    struct job {
+        task_fn fn{};
+        void* ctx{};
+        size_t n{};
+    };
+
+    void work(const job& j) {
+        for (size_t i; (i = next_.fetch_add(1, std::memory_order_relaxed)) < j.n;) {
+            j.fn(j.ctx, i);
+            done_.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void helper_loop() {
+        uint64_t seen = 0;
+        for (;;) {
+            job j;
+            {
+                std::unique_lock lk(lock_);
+                cond_.wait(lk, [&]() { return shutdown_ || generation_ != seen; });
+                if (shutdown_)
+                    return;
+                seen = generation_;
+                j = job_;
+                active_.fetch_add(1, std::memory_order_relaxed);
+            }
+            work(j);
+            active_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    std::mutex lock_;
+    std::condition_variable cond_;
+    uint64_t generation_{};  // guarded by lock_, as are job_ and shutdown_
+    job job_;
+    bool shutdown_{};
+    std::atomic<size_t> active_{};  // helpers inside work()
+    std::atomic<size_t> next_{};
+    std::atomic<size_t> done_{};
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace orderbook
@@ -0,0 +1,88 @@
+#pragma once
+#include <limits>
+#include <string>
+
+#include "shm_gateway.hpp"
+
+namespace orderbook {
+
+// client side of the shared memory gateway, for one client thread. requests
+// are tagged with increasing sequence numbers starting at 1. the send calls
+// return 0 when the request ring is full; keep draining the responses with
+// poll() meanwhile, the engine stalls once the response ring fills up
+class gateway_client {
+ public:
+    // waits for the engine to finish setting up the region
+    explicit gateway_client(const std::string& name)
+        : shm_(shm_mapping::open(name)) {}
+
+    uint64_t add_order(
+        uint32_t oid, const sym_t& sym, side_t side, qty_t qty, price_t prc) {
+        shm_command req;
+        req.type = command::ADD;
+        req.oid = oid;
+        req.sym = sym;
+        req.side = static_cast<uint8_t>(side);
+        req.qty = qty;
+        req.prc = prc;
+        return send(req);
+    }
+
+    uint64_t cxl_order(uint32_t oid) {
+        shm_command req;
+        req.type = command::CXL;
+        req.oid = oid;
+        return send(req);
+    }
+
+    // cancels the orders of sym on side (both for UNKNOWN) with lo <= prc <= hi
+    uint64_t mass_cxl(const sym_t& sym, side_t side = UNKNOWN, price_t lo = 0,
+        price_t hi = std::numeric_limits<price_t>::max()) {
+        shm_command req;
+        req.type = command::MASS_CXL;
+        req.sym = sym;
+        req.side = static_cast<uint8_t>(side);
+        req.prc = lo;
+        req.prc_hi = hi;
+        return send(req);
+    }
+
+    uint64_t print_books() {
+        shm_command req;
+        req.type = command::PRINT;
+        return send(req);
+    }
+
+    // asks the engine to stop once everything sent before has been processed
+    uint64_t stop_engine() {
+        shm_command req;
+        req.type = command::END;
+        return send(req);
+    }
+
+    // hands every available response to handler(const shm_result&), a
+    // response of kind result_rec::EOL acks the request with the same seq
+    template <typename Handler>
+    size_t poll(Handler&& handler) {
+        size_t n = 0;
+        shm_result res;
+        while (shm_->responses.try_pop(res)) {
+            handler(static_cast<const shm_result&>(res));
+            ++n;
+        }
+        return n;
+    }
+
+ private:
+    uint64_t send(shm_command& req) {
+        req.seq = next_seq_;
+        if (!shm_->requests.try_push(std::move(req)))
+            return 0;
+        return next_seq_++;
+    }
+
+    shm_mapping shm_;
+    uint64_t next_seq_{1};
+};
+
+}  // namespace orderbook
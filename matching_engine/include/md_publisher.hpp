@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "../../worker_pool.hpp"
+#include "book_delta.hpp"
+#include "orderbook.hpp"
+#include "spsc_ring.hpp"
+#include "utils.hpp"
+
+namespace orderbook {
+
+// publishes book deltas to a slow consumer off the matching thread. deltas of
+// a symbol that arrive while one is still waiting to be published are merged
+// into it, and a symbol is published at most once per min_interval. the
+// matching thread hands deltas over through a ring that the pump thread
+// drains into the pool, so it never waits on a lock the pool holds
+class md_publisher
+    : public worker_pool<md_publisher, sym_t, book_delta, book_key_hasher> {
+    using pool_t = worker_pool<md_publisher, sym_t, book_delta, book_key_hasher>;
+
+ public:
+    using publish_fn = std::function<void(const book_delta&)>;
+
+    md_publisher(publish_fn fn,
+        std::chrono::microseconds min_interval = std::chrono::microseconds(1000),
+        size_t num_workers = 1, worker_options opts = {})
+        : pool_t(num_workers, std::move(opts)),
+          publish_(std::move(fn)),
+          min_interval_(min_interval) {}
+    ~md_publisher() { stop(); }
+
+    // feeds the book deltas of mgr into this publisher
+    void attach(OrderBookMgr& mgr) { mgr.set_delta_sink(&on_delta, this); }
+
+    void start(std::chrono::microseconds pump_interval =
+                   std::chrono::microseconds(100)) {
+        pool_t::start();
+        if (pump_.joinable())
+            return;
+        pumping_ = true;
+        pump_ = std::thread([this, pump_interval]() {
+            while (pumping_.load(std::memory_order_relaxed)) {
+                drain();
+                process_all();
+                std::this_thread::sleep_for(pump_interval);
+            }
+        });
+    }
+
+    // publishes what is still pending, ignoring the rate limit, then stops.
+    // call it from the matching thread or once that is done
+    void stop() {
+        if (!pump_.joinable())
+            return;
+        pumping_ = false;
+        pump_.join();
+        drain();
+        for (auto& [sym, delta] : backlog_)  // newer than anything in the ring
+            add_work(sym, std::move(delta));
+        backlog_.clear();
+        flushing_ = true;
+        for (;;) {
+            process_all();
+            auto st = stats();
+            if (!st.dirty_keys && !st.queue_depth && !st.in_progress)
+                break;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        pool_t::stop();
+    }
+
+    // deltas merged into a pending one instead of being published on their own
+    size_t conflated() const {
+        return stats().merges + held_merges_.load(std::memory_order_relaxed);
+    }
+    size_t published() const {
+        return published_.load(std::memory_order_relaxed);
+    }
+
+    // worker_pool hooks
+    bool should_process(const sym_t& sym, const book_delta&,
+        const std::chrono::system_clock::time_point& now) {
+        if (flushing_.load(std::memory_order_relaxed))
+            return true;
+        std::lock_guard lk(last_publish_lock_);
+        auto it = last_publish_.find(sym);
+        return it == last_publish_.end() || now - it->second >= min_interval_;
+    }
+
+    void process(const sym_t& sym, book_delta delta) {
+        publish_(delta);
+        published_.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard lk(last_publish_lock_);
+        last_publish_[sym] = std::chrono::system_clock::now();
+    }
+
+ private:
+    // runs on the matching thread and never blocks. while the ring is full
+    // deltas wait in backlog_, where a later delta of the same symbol is
+    // merged in rather than overtaking it through the ring
+    static void on_delta(void* ctx, book_delta&& delta) {
+        auto* self = static_cast<md_publisher*>(ctx);
+        if (!self->backlog_.empty())
+            self->flush_backlog();
+        if (!self->backlog_.empty() ||
+            !self->deltas_.try_push(std::move(delta)))
+            self->hold(std::move(delta));
+    }
+
+    // matching thread side of the ring
+    void hold(book_delta&& delta) {
+        auto sym = delta.sym;
+        auto [it, inserted] = backlog_.try_emplace(sym, std::move(delta));
+        if (!inserted) {
+            it->second.merge(std::move(delta));
+            held_merges_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    void flush_backlog() {
+        for (auto it = backlog_.begin(); it != backlog_.end();) {
+            if (!deltas_.try_push(std::move(it->second)))
+                return;  // left untouched, retried with the next delta
+            it = backlog_.erase(it);
+        }
+    }
+
+    // pump thread side of the ring
+    void drain() {
+        book_delta delta;
+        while (deltas_.try_pop(delta)) {
+            auto sym = delta.sym;
+            add_work(sym, std::move(delta));
+        }
+    }
+
+    spsc_ring<book_delta, 4096> deltas_;
+    std::unordered_map<sym_t, book_delta, book_key_hasher> backlog_;
+    std::atomic<size_t> held_merges_{};
+    publish_fn publish_;
+    std::chrono::microseconds min_interval_;
+    std::thread pump_;
+    std::atomic<bool> pumping_{};
+    std::atomic<bool> flushing_{};
+    std::atomic<size_t> published_{};
+    std::mutex last_publish_lock_;
+    std::unordered_map<sym_t, std::chrono::system_clock::time_point,
+        book_key_hasher>
+        last_publish_;
+};
+
+}  // namespace orderbook
@@ -1,6 +1,24 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+/// Point-in-time usage of an obj_pool
+struct obj_pool_stats {
+    size_t slabs = 0;       // slabs currently allocated
+    size_t objects = 0;     // object slots in those slabs
+    size_t in_use = 0;      // slots handed out
+    size_t high_water = 0;  // most slots ever in use at once
+    size_t bytes = 0;       // address space held by the slabs, pages trim() discarded included
+};
 
 template <typename T, size_t Alignment = std::alignment_of_v<T>>
 class obj_pool final {
@@ -14,15 +32,25 @@ class obj_pool final {
 
     obj_deleter od_;
     std::vector<T*> free_objs_;
+    std::vector<std::byte*> slabs_;  // sorted by address
     size_t allocated_objs_ = 0;
+    size_t high_water_ = 0;
 
-    /// pre-allocate uninitialized object memorys and store them in pool
+    /// pre-allocate uninitialized object memorys in slabs of batch_count objects and store them in pool.
+    /// slabs are mapped straight from the OS so trim() can hand their pages back, freed malloc memory
+    /// would only go to malloc's free lists
     void grow(size_t sz = batch_count) {
-        for (size_t i = 0; i < sz; ++i) {
-            auto* b = malloc(obj_sz);
-            free_objs_.push_back(static_cast<T*>(b));
+        for (size_t n = 0; n < sz; n += batch_count) {
+            void* mem = ::mmap(nullptr, slab_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED)
+                throw std::bad_alloc();
+            auto* slab = static_cast<std::byte*>(mem);
+            slabs_.insert(std::upper_bound(slabs_.begin(), slabs_.end(), slab, std::less<>()), slab);
+            // pushed last to first so make() hands them out in address order
+            for (size_t i = batch_count; i-- > 0;)
+                free_objs_.push_back(reinterpret_cast<T*>(slab + i * obj_sz));
+            allocated_objs_ += batch_count;
         }
-        allocated_objs_ += sz;
     }
 
     /// Call object destructor and release the memory to pool
@@ -33,18 +61,43 @@ class obj_pool final {
         }
     }
     static constexpr size_t PAGE_SIZE = 4096;
+    /// slabs are a multiple of this, which is a multiple of every page size Linux uses, so slab
+    /// boundaries are page boundaries
+    static constexpr size_t SLAB_UNIT = 64 * 1024;
 
     /// Round an unsigned integer up to a multiple of some other integer
     static inline constexpr size_t round_to_mult(size_t v, uint64_t multiple) {
         return static_cast<size_t>((v + multiple - 1) / multiple * multiple);
     }
 
+    static size_t page_size() {
+        static const size_t sz = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        return sz;
+    }
+
+    /// Bytes of [p, p + len) backed by physical pages, p and len page aligned
+    static size_t resident_bytes(std::byte* p, size_t len) {
+        std::vector<unsigned char> vec(len / page_size());
+        if (::mincore(p, len, vec.data()) != 0)
+            return 0;
+        return static_cast<size_t>(std::count_if(vec.begin(), vec.end(), [](unsigned char v) { return v & 1; })) *
+               page_size();
+    }
+
+    /// Index of the slab holding t
+    size_t slab_of(const T* t) const {
+        auto* p = reinterpret_cast<const std::byte*>(t);
+        return static_cast<size_t>(std::upper_bound(slabs_.begin(), slabs_.end(), p, std::less<>()) - slabs_.begin() - 1);
+    }
+
  public:
     using unique_ptr = std::unique_ptr<T, obj_deleter>;
     static constexpr size_t obj_sz = round_to_mult(sizeof(T), align_sz);
     static_assert(obj_sz < PAGE_SIZE, "Object too large for obj_pool");
 
-    static constexpr size_t batch_count = 128;
+    /// at least 128 objects per slab, and as many more as fill the SLAB_UNIT multiple
+    static constexpr size_t slab_sz = round_to_mult(obj_sz * 128, SLAB_UNIT);
+    static constexpr size_t batch_count = slab_sz / obj_sz;
 
     obj_pool(obj_pool&&) = default;
     obj_pool(const obj_pool&) = delete;
@@ -52,8 +105,8 @@ class obj_pool final {
     obj_pool& operator=(const obj_pool&) = delete;
     obj_pool() : od_{this} {}
     ~obj_pool() {
-        for(auto* mem: free_objs_) {
-            std::free(mem);
+        for (auto* slab : slabs_) {
+            ::munmap(slab, slab_sz);
         }
     }
 
@@ -63,15 +116,103 @@ class obj_pool final {
     /// Return number of free object memory chunks can be used
     size_t free_size() const { return free_objs_.size(); }
 
+    /// Return number of objects handed out and not released yet
+    size_t in_use() const { return allocated_objs_ - free_objs_.size(); }
+
+    /// Return the largest in_use() seen so far
+    size_t high_water() const { return high_water_; }
+
+    /// Return bytes held by the slabs, including free slots
+    size_t bytes() const { return slabs_.size() * slab_sz; }
+
+    obj_pool_stats stats() const {
+        return {slabs_.size(), allocated_objs_, in_use(), high_water_, bytes()};
+    }
+
     /// Request number of free object memory chunks not less than sz
     void reserve(size_t sz) {
         auto fsz = free_objs_.size();
-        if (SLOW_PATH(sz <= fsz))
+        if (sz <= fsz)
             return;
         auto rsz = round_to_mult(sz - fsz, batch_count);
         grow(rsz);
     }
 
+    /// Return memory of free slots to the OS, keeping the keep_free free slots make() hands out next
+    /// resident. Slabs with no object in use are unmapped, and in the others every page whose slots
+    /// are all free is discarded: it stays mapped, its slots stay in the pool and fault back in as
+    /// zero pages when reused. Returns the bytes that were resident and no longer are
+    size_t trim(size_t keep_free = 0) {
+        if (free_objs_.size() <= keep_free)
+            return 0;
+        // make() pops from the back, so the front of free_objs_ is what won't be needed soon
+        size_t cold = free_objs_.size() - keep_free;
+        const size_t page = page_size();
+        const size_t pages = slab_sz / page;
+
+        // slots overlapping each page of a slab, a slot across a page boundary counts for both
+        std::vector<uint32_t> slots_in_page(pages);
+        for (size_t p = 0; p < pages; ++p) {
+            size_t first = p * page / obj_sz;
+            size_t last = std::min(batch_count, ((p + 1) * page + obj_sz - 1) / obj_sz);
+            slots_in_page[p] = static_cast<uint32_t>(last > first ? last - first : 0);
+        }
+        std::vector<uint32_t> free_in_slab(slabs_.size());
+        std::vector<uint32_t> free_in_page(slabs_.size() * pages);
+        for (size_t i = 0; i < cold; ++i) {
+            size_t s = slab_of(free_objs_[i]);
+            size_t off = static_cast<size_t>(reinterpret_cast<std::byte*>(free_objs_[i]) - slabs_[s]);
+            ++free_in_slab[s];
+            for (size_t p = off / page; p <= (off + obj_sz - 1) / page; ++p)
+                ++free_in_page[s * pages + p];
+        }
+
+        size_t released = 0;
+        std::vector<bool> unmap(slabs_.size());
+        size_t unmapped = 0;
+        for (size_t s = 0; s < slabs_.size(); ++s) {
+            if (free_in_slab[s] == batch_count) {
+                unmap[s] = true;
+                ++unmapped;
+                continue;
+            }
+            // discard the runs of fully free pages
+            for (size_t p = 0; p < pages;) {
+                auto is_free = [&](size_t q) { return slots_in_page[q] && free_in_page[s * pages + q] == slots_in_page[q]; };
+                if (!is_free(p)) {
+                    ++p;
+                    continue;
+                }
+                size_t q = p;
+                while (q < pages && is_free(q))
+                    ++q;
+                auto* run = slabs_[s] + p * page;
+                size_t len = (q - p) * page;
+                size_t resident = resident_bytes(run, len);
+                if (resident && ::madvise(run, len, MADV_DONTNEED) == 0)
+                    released += resident;
+                p = q;
+            }
+        }
+        if (!unmapped)
+            return released;
+
+        std::erase_if(free_objs_, [&](T* t) { return unmap[slab_of(t)]; });
+        free_objs_.shrink_to_fit();
+        size_t j = 0;
+        for (size_t s = 0; s < slabs_.size(); ++s) {
+            if (unmap[s]) {
+                released += resident_bytes(slabs_[s], slab_sz);
+                ::munmap(slabs_[s], slab_sz);
+            } else {
+                slabs_[j++] = slabs_[s];
+            }
+        }
+        slabs_.resize(j);
+        allocated_objs_ -= unmapped * batch_count;
+        return released;
+    }
+
     template <typename... Args>
     unique_ptr make(Args&&... args) {
         if (free_objs_.empty())
@@ -79,6 +220,7 @@ class obj_pool final {
 
         auto* p = free_objs_.back();
         free_objs_.pop_back();
+        high_water_ = std::max(high_water_, in_use());
         return unique_ptr(new (p) T{std::forward<Args>(args)...}, od_);
     }
 };
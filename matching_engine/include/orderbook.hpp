@@ -1,10 +1,19 @@
 #pragma once
+#include <algorithm>
+#include <fstream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include <malloc.h>
+#include <unistd.h>
+
+#include "book_delta.hpp"
+#include "command.hpp"
+#include "fork_join.hpp"
 #include "obj_pool.hpp"
 #include "output_collector.hpp"
 #include "utils.hpp"
@@ -20,6 +29,8 @@ struct PriceLevel {
     PriceLevel(price_t p, side_t s) : prc(p), side(s) {}
     price_t prc{};
     side_t side{};
+    uint32_t qty{};  // sum of the qty of ords, kept up to date for the deltas
+    bool touched{};  // already in the book's changed_, cleared by take_delta
     OrderBook* ob{};
     std::list<Order*> ords;
 };
@@ -33,9 +44,34 @@ struct Order {
     auto side() const { return pl->side; }
 };
 
+// estimated heap footprint of a container node holding a value of size
+// value_sz with links links pointers, allocator overhead not included
+inline constexpr size_t node_bytes(size_t value_sz, size_t links) {
+    return value_sz + links * sizeof(void*);
+}
+
+// memory held by one book, outside the shared pools
+struct book_usage {
+    sym_t sym{};
+    size_t levels{};
+    size_t orders{};
+    size_t bytes{};
+};
+
 class OrderBook {
  public:
-    explicit OrderBook(sym_t symbol) : symbol_(symbol) {}
+    // levels come from pl_pool, which is shared by the books of a manager so
+    // an idle book holds no pre-grown level memory
+    OrderBook(sym_t symbol, obj_pool<PriceLevel>& pl_pool)
+        : symbol_(symbol), pl_pool_(&pl_pool) {}
+
+    bool empty() const { return bids_.empty() && asks_.empty(); }
+    // the book itself, its level maps and order lists and its change buffer.
+    // the levels and orders are counted with their pools
+    book_usage memory_usage() const;
+    // value of the manager's command counter when the book was last changed
+    uint64_t last_used() const { return last_used_; }
+    void set_last_used(uint64_t tick) { last_used_ = tick; }
 
     template <side_t SIDE>
     void match_order(Order* ord, price_t prc,
@@ -46,17 +82,51 @@ class OrderBook {
 
     void remove_order(const Order* ord);
 
+    // cancels every order of the levels on one side with lo <= prc <= hi.
+    // levels go from the most aggressive, orders in time priority
+    template <side_t SIDE>
+    void cxl_levels(price_t lo, price_t hi,
+        std::unordered_map<uint32_t, obj_pool<Order>::unique_ptr>& ord_map);
+
     void print_book();
+    // appends the lines of print_book to out, returns how many
+    size_t snapshot(std::string& out) const;
+
+    // record the levels touched by each command, for take_delta
+    void track_changes(bool on) { tracking_ = on; }
+    // the best prices and the changed levels since the last call, false if
+    // nothing changed
+    bool take_delta(book_delta& delta);
 
  private:
     template <side_t SIDE, typename Levels>
     void do_add_order(Levels& lvls, Order* ord, price_t prc);
     template <side_t SIDE, typename Levels>
+    void do_cxl_levels(Levels& lvls, typename Levels::iterator first,
+        typename Levels::iterator last,
+        std::unordered_map<uint32_t, obj_pool<Order>::unique_ptr>& ord_map);
+    template <side_t SIDE, typename Levels>
     void do_match_order(Levels& lvls, Order* ord, price_t prc,
         std::unordered_map<uint32_t, obj_pool<Order>::unique_ptr>& ord_map);
 
+    // the flag on the level keeps each level in changed_ once, however many
+    // of its orders a sweep fills
+    void touch(PriceLevel* pl) {
+        if (tracking_ && !pl->touched) {
+            pl->touched = true;
+            changed_.push_back({pl->side, pl->prc, 0});
+        }
+    }
+    template <typename Levels>
+    static PriceLevel* find_level(const Levels& lvls, price_t prc);
+    template <typename Levels>
+    static uint32_t level_qty(const Levels& lvls, price_t prc);
+
     sym_t symbol_{};
-    obj_pool<PriceLevel> pl_pool_;
+    bool tracking_{};
+    uint64_t last_used_{};
+    std::vector<level_update> changed_;
+    obj_pool<PriceLevel>* pl_pool_{};
     // sorted from most aggressive to least aggressive
     std::map<price_t, obj_pool<PriceLevel>::unique_ptr, std::greater<>> bids_;
     std::map<price_t, obj_pool<PriceLevel>::unique_ptr> asks_;
@@ -67,10 +137,70 @@ class OrderBookMgr {
     void add_order(
         uint32_t oid, const sym_t& sym, side_t side, qty_t qty, price_t prc);
     void cxl_order(uint32_t oid);
+    // mass cancel, bids before asks. an ack is logged for every order
+    void cxl_symbol(const sym_t& sym);
+    void cxl_side(const sym_t& sym, side_t side);
+    void cxl_range(const sym_t& sym, side_t side, price_t lo, price_t hi);
     void print_books();
+    void execute(const command& cmd);
+
+    // P formats large snapshots on this many helper threads plus the calling
+    // one, 0 formats them on the calling thread only. the work is split by
+    // book, a single deep book is still formatted on one thread. unused while
+    // the log has a sink, P then emits per-order records for the consumer
+    void set_snapshot_threads(size_t threads);
+
+    // after every command, the delta of the book it changed is handed to the
+    // sink. the sink runs on the matching thread and must not block
+    using delta_sink_fn = void (*)(void* ctx, book_delta&& delta);
+    void set_delta_sink(delta_sink_fn fn, void* ctx);
+
+    struct memory_report {
+        std::vector<book_usage> books;
+        size_t book_index_bytes{};   // books_ buckets and nodes, without the books
+        size_t order_index_bytes{};  // orders_ buckets and nodes
+        size_t snapshot_bytes{};     // P buffers kept for reuse
+        obj_pool_stats order_pool;
+        obj_pool_stats level_pool;
+        size_t total_bytes() const;
+    };
+    memory_report memory() const;
+    // releases the free pool memory, the P buffers and the spare buckets of
+    // the order index, returns the bytes given back to the OS
+    size_t trim();
+
+    // drops the books without orders that no command changed in the last
+    // idle_commands commands, returns how many. an evicted book behaves as if
+    // it was never created, except for P: books_ is unordered, so a symbol
+    // that comes back may be listed at a different place than before
+    size_t evict_idle_books(uint64_t idle_commands = 0);
+    // runs evict_idle_books(idle_commands) from execute once every
+    // idle_commands book changing commands, 0 turns it off
+    void set_auto_evict(uint64_t idle_commands);
+    size_t book_count() const { return books_.size(); }
+    size_t evicted() const { return evicted_; }
 
  private:
+    void publish(OrderBook& book);
+
+    // the output of one book in a P, the buffers are kept for the next one
+    struct book_snapshot {
+        const OrderBook* book{};
+        std::string lines;
+        size_t count{};
+    };
+    static constexpr size_t PARALLEL_SNAPSHOT_ORDERS = 4096;
+    std::vector<book_snapshot> snapshots_;
+    std::unique_ptr<fork_join> snapshot_workers_;
+
+    delta_sink_fn delta_sink_{};
+    void* delta_sink_ctx_{};
+    uint64_t tick_{};  // counts the commands that changed a book
+    uint64_t auto_evict_{};
+    uint64_t next_evict_{};  // tick_ of the next auto eviction
+    size_t evicted_{};
     obj_pool<Order> ord_pool_;
+    obj_pool<PriceLevel> pl_pool_;  // shared by all books, outlives them
     std::unordered_map<sym_t, OrderBook, book_key_hasher> books_;
     std::unordered_map<uint32_t, obj_pool<Order>::unique_ptr> orders_;
 };
@@ -94,8 +224,45 @@ void OrderBook::add_order(Order* ord, price_t prc) {
     }
 }
 
+template <side_t SIDE>
+void OrderBook::cxl_levels(price_t lo, price_t hi,
+    std::unordered_map<uint32_t, obj_pool<Order>::unique_ptr>& ord_map) {
+    if (lo > hi)
+        return;  // the bounds would cross and erase would walk past end()
+    if constexpr (SIDE == BUY) {
+        // bids are sorted high to low
+        do_cxl_levels<BUY>(bids_, bids_.lower_bound(hi), bids_.upper_bound(lo),
+            ord_map);
+    } else {
+        do_cxl_levels<SELL>(asks_, asks_.lower_bound(lo),
+            asks_.upper_bound(hi), ord_map);
+    }
+}
+
+template <side_t SIDE, typename Levels>
+void OrderBook::do_cxl_levels(Levels& lvls, typename Levels::iterator first,
+    typename Levels::iterator last,
+    std::unordered_map<uint32_t, obj_pool<Order>::unique_ptr>& ord_map) {
+    if (first == last)
+        return;
+    for (auto it = first; it != last; ++it) {
+        auto& pl = it->second;
+        touch(pl.get());
+        for (auto* ord : pl->ords) {
+            auto oid = ord->oid;
+            ord_map.erase(oid);  // returns the order to the pool, ords only
+                                 // holds the pointer
+            log.add_cxl(oid);
+        }
+    }
+    // the levels and their order lists go in one erase, no per-order unlink
+    lvls.erase(first, last);
+}
+
 void OrderBook::remove_order(const Order* ord) {
+    touch(ord->pl);
     // remove the order from price level
+    ord->pl->qty -= ord->qty;
     ord->pl->ords.erase(ord->ord_it);
 
     // remove the price level if it is empty
@@ -125,23 +292,98 @@ void OrderBook::print_book() {
         }
     }
 }
+book_usage OrderBook::memory_usage() const {
+    book_usage usage;
+    usage.sym = symbol_;
+    usage.levels = bids_.size() + asks_.size();
+    for (auto& [prc, pl] : bids_)
+        usage.orders += pl->ords.size();
+    for (auto& [prc, pl] : asks_)
+        usage.orders += pl->ords.size();
+    // map nodes are red-black tree nodes: color, parent, left and right
+    usage.bytes = sizeof(*this) +
+                  usage.levels * node_bytes(sizeof(price_t) + sizeof(void*), 4) +
+                  usage.orders * node_bytes(sizeof(Order*), 2) +
+                  changed_.capacity() * sizeof(level_update);
+    return usage;
+}
+size_t OrderBook::snapshot(std::string& out) const {
+    size_t count = 0;
+    for (auto it = asks_.rbegin(); it != asks_.rend(); ++it) {
+        auto& [prc, pl] = *it;
+        for (auto ord_it = pl->ords.rbegin(); ord_it != pl->ords.rend();
+             ++ord_it) {
+            auto* ord = *ord_it;
+            append_order(out, symbol_, ord->oid, SELL, ord->qty, prc);
+            ++count;
+        }
+    }
+    for (auto& [prc, pl] : bids_) {
+        for (auto* ord : pl->ords) {
+            append_order(out, symbol_, ord->oid, BUY, ord->qty, prc);
+            ++count;
+        }
+    }
+    return count;
+}
+template <typename Levels>
+PriceLevel* OrderBook::find_level(const Levels& lvls, price_t prc) {
+    auto it = lvls.find(prc);
+    return it == lvls.end() ? nullptr : it->second.get();
+}
+template <typename Levels>
+uint32_t OrderBook::level_qty(const Levels& lvls, price_t prc) {
+    auto* pl = find_level(lvls, prc);
+    return pl ? pl->qty : 0;
+}
+bool OrderBook::take_delta(book_delta& delta) {
+    if (changed_.empty())
+        return false;
+    delta.sym = symbol_;
+    delta.bid_prc = bids_.empty() ? 0 : bids_.begin()->first;
+    delta.bid_qty = bids_.empty() ? 0 : level_qty(bids_, delta.bid_prc);
+    delta.ask_prc = asks_.empty() ? 0 : asks_.begin()->first;
+    delta.ask_qty = asks_.empty() ? 0 : level_qty(asks_, delta.ask_prc);
+    delta.levels.clear();
+    for (auto& lvl : changed_) {
+        auto* pl = lvl.side == BUY ? find_level(bids_, lvl.prc)
+                                   : find_level(asks_, lvl.prc);
+        if (pl)
+            pl->touched = false;
+        delta.levels.push_back({lvl.side, lvl.prc, pl ? pl->qty : 0});
+    }
+    changed_.clear();
+    // book_delta::merge relies on the order. a level removed and made again
+    // at the same price shows up twice, with the same qty, unique drops one
+    std::sort(delta.levels.begin(), delta.levels.end(), level_before);
+    delta.levels.erase(std::unique(delta.levels.begin(), delta.levels.end(),
+                           [](auto& a, auto& b) {
+                               return a.side == b.side && a.prc == b.prc;
+                           }),
+        delta.levels.end());
+    return true;
+}
 template <side_t SIDE, typename Levels>
 void OrderBook::do_add_order(Levels& lvls, Order* ord, price_t prc) {
     auto it = lvls.find(prc);
     if (it == lvls.end()) {
         // create a new price level
-        auto pl = pl_pool_.make(prc, SIDE);
+        auto pl = pl_pool_->make(prc, SIDE);
         ord->pl = pl.get();
         pl->ords.push_back(ord);
+        pl->qty = ord->qty;
         pl->ob = this;
         ord->ord_it = std::prev(pl->ords.end());
+        touch(pl.get());
         lvls.emplace(prc, std::move(pl));
     } else {
         // add to existing price level
         auto& pl = it->second;
         ord->pl = pl.get();
         pl->ords.push_back(ord);
+        pl->qty += ord->qty;
         ord->ord_it = std::prev(pl->ords.end());
+        touch(pl.get());
     }
 }
 template <side_t SIDE, typename Levels>
@@ -155,11 +397,13 @@ void OrderBook::do_match_order(Levels& lvls, Order* ord, price_t prc,
             break;
         }
 
+        touch(pl.get());
         auto& ords = pl->ords;
         auto& top_ord = ords.front();
         if (top_ord->qty > ord->qty) {
             // top order is larger than incoming order
             top_ord->qty -= ord->qty;
+            pl->qty -= ord->qty;
             log.add_fill(symbol_, ord->oid, ord->qty, pl->prc);
             log.add_fill(symbol_, top_ord->oid, ord->qty, pl->prc);
             ord->qty = 0;
@@ -168,6 +412,7 @@ void OrderBook::do_match_order(Levels& lvls, Order* ord, price_t prc,
             ord->qty -= top_ord->qty;
             log.add_fill(symbol_, ord->oid, top_ord->qty, pl->prc);
             log.add_fill(symbol_, top_ord->oid, top_ord->qty, pl->prc);
+            pl->qty -= top_ord->qty;
             top_ord->qty = 0;
             auto remove_oid = top_ord->oid;
             remove_order(top_ord);
@@ -183,9 +428,12 @@ void OrderBookMgr::add_order(
         log.add_err(std::to_string(oid) + " Duplicate order id");
         return;
     }
-    auto [book_it, bb] = books_.try_emplace(sym, sym);
+    auto [book_it, bb] = books_.try_emplace(sym, sym, pl_pool_);
+    if (bb && delta_sink_)
+        book_it->second.track_changes(true);
     auto& ord = it->second;
     auto& book = book_it->second;
+    book.set_last_used(++tick_);
     if (side == BUY) {
         book.match_order<BUY>(ord.get(), prc, orders_);
         if (ord->qty > 0)
@@ -198,6 +446,7 @@ void OrderBookMgr::add_order(
     if (ord->qty == 0) {
         orders_.erase(it);
     }
+    publish(book);
 }
 void OrderBookMgr::cxl_order(uint32_t oid) {
     auto it = orders_.find(oid);
@@ -206,13 +455,167 @@ void OrderBookMgr::cxl_order(uint32_t oid) {
         return;
     }
     auto& order = it->second;
-    order->book()->remove_order(order.get());
+    auto* book = order->book();
+    book->set_last_used(++tick_);
+    book->remove_order(order.get());
     orders_.erase(it);
     log.add_cxl(oid);
+    publish(*book);
+}
+void OrderBookMgr::cxl_symbol(const sym_t& sym) {
+    cxl_range(sym, UNKNOWN, 0, std::numeric_limits<price_t>::max());
+}
+void OrderBookMgr::cxl_side(const sym_t& sym, side_t side) {
+    cxl_range(sym, side, 0, std::numeric_limits<price_t>::max());
+}
+void OrderBookMgr::cxl_range(
+    const sym_t& sym, side_t side, price_t lo, price_t hi) {
+    if (lo > hi) {
+        log.add_err(to_string(sym) + " Invalid prc");
+        return;
+    }
+    auto it = books_.find(sym);
+    if (it == books_.end()) {
+        log.add_err(to_string(sym) + " Book not found");
+        return;
+    }
+    auto& book = it->second;
+    book.set_last_used(++tick_);
+    if (side != SELL)
+        book.cxl_levels<BUY>(lo, hi, orders_);
+    if (side != BUY)
+        book.cxl_levels<SELL>(lo, hi, orders_);
+    publish(book);
 }
 void OrderBookMgr::print_books() {
-    for (auto& [sym, book] : books_) {
-        book.print_book();
+    if (log.has_sink()) {
+        // the records are formatted by whoever consumes them
+        for (auto& [sym, book] : books_) {
+            book.print_book();
+        }
+        return;
+    }
+    // every book is formatted into its own buffer, then they are appended in
+    // books_ order. the books don't change until the call returns
+    snapshots_.resize(books_.size());
+    size_t i = 0;
+    for (auto& [sym, book] : books_)
+        snapshots_[i++].book = &book;
+    auto format = [](void* ctx, size_t idx) {
+        auto& snap = (*static_cast<std::vector<book_snapshot>*>(ctx))[idx];
+        snap.lines.clear();
+        snap.count = snap.book->snapshot(snap.lines);
+    };
+    if (snapshot_workers_ && orders_.size() >= PARALLEL_SNAPSHOT_ORDERS) {
+        snapshot_workers_->run(snapshots_.size(), format, &snapshots_);
+    } else {
+        for (i = 0; i < snapshots_.size(); ++i)
+            format(&snapshots_, i);
+    }
+    for (auto& snap : snapshots_)
+        log.add_block(snap.lines, snap.count);
+}
+void OrderBookMgr::set_snapshot_threads(size_t threads) {
+    snapshot_workers_.reset(threads ? new fork_join(threads) : nullptr);
+}
+void OrderBookMgr::set_delta_sink(delta_sink_fn fn, void* ctx) {
+    delta_sink_ = fn;
+    delta_sink_ctx_ = ctx;
+    for (auto& [sym, book] : books_)
+        book.track_changes(fn != nullptr);
+}
+size_t OrderBookMgr::memory_report::total_bytes() const {
+    size_t total = book_index_bytes + order_index_bytes + snapshot_bytes +
+                   order_pool.bytes + level_pool.bytes;
+    for (auto& book : books)
+        total += book.bytes;
+    return total;
+}
+OrderBookMgr::memory_report OrderBookMgr::memory() const {
+    memory_report report;
+    report.books.reserve(books_.size());
+    for (auto& [sym, book] : books_)
+        report.books.push_back(book.memory_usage());
+    // the hash codes are not cached for book_key_hasher, they are for
+    // std::hash<uint32_t>
+    report.book_index_bytes = books_.bucket_count() * sizeof(void*) +
+                              books_.size() * node_bytes(sizeof(sym_t), 1);
+    report.order_index_bytes =
+        orders_.bucket_count() * sizeof(void*) +
+        orders_.size() *
+            node_bytes(sizeof(uint32_t) + sizeof(obj_pool<Order>::unique_ptr) +
+                           sizeof(size_t),
+                1);
+    report.snapshot_bytes = snapshots_.capacity() * sizeof(book_snapshot);
+    for (auto& snap : snapshots_)
+        report.snapshot_bytes += snap.lines.capacity();
+    report.order_pool = ord_pool_.stats();
+    report.level_pool = pl_pool_.stats();
+    return report;
+}
+// resident set of the whole process
+inline size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+size_t OrderBookMgr::trim() {
+    // the pools count the pages they drop themselves. the rest is malloc
+    // memory, which leaves the process only when malloc_trim hands it back,
+    // so it is measured on the resident set. allocations by other threads in
+    // between can hide part of it
+    size_t released = ord_pool_.trim() + pl_pool_.trim();
+    auto before = resident_bytes();
+    std::vector<book_snapshot>().swap(snapshots_);
+    // the bucket array stays at its peak size otherwise
+    orders_.rehash(0);
+    ::malloc_trim(0);
+    auto after = resident_bytes();
+    return released + (before > after ? before - after : 0);
+}
+size_t OrderBookMgr::evict_idle_books(uint64_t idle_commands) {
+    auto n = std::erase_if(books_, [&](const auto& kv) {
+        auto& book = kv.second;
+        return book.empty() && tick_ - book.last_used() >= idle_commands;
+    });
+    evicted_ += n;
+    return n;
+}
+void OrderBookMgr::set_auto_evict(uint64_t idle_commands) {
+    auto_evict_ = idle_commands;
+    next_evict_ = tick_ + idle_commands;
+}
+void OrderBookMgr::publish(OrderBook& book) {
+    if (!delta_sink_)
+        return;
+    book_delta delta;
+    if (book.take_delta(delta))
+        delta_sink_(delta_sink_ctx_, std::move(delta));
+}
+void OrderBookMgr::execute(const command& cmd) {
+    switch (cmd.type) {
+        case command::ADD:
+            add_order(cmd.oid, cmd.sym, cmd.side, cmd.qty, cmd.prc);
+            break;
+        case command::CXL:
+            cxl_order(cmd.oid);
+            break;
+        case command::MASS_CXL:
+            cxl_range(cmd.sym, cmd.side, cmd.prc, cmd.prc_hi);
+            break;
+        case command::PRINT:
+            print_books();
+            break;
+        case command::ERR:
+            log.add_err(*cmd.err);
+            break;
+        default:
+            break;
+    }
+    if (auto_evict_ && tick_ >= next_evict_) {
+        evict_idle_books(auto_evict_);
+        next_evict_ = tick_ + auto_evict_;
     }
 }
 }  // namespace orderbook
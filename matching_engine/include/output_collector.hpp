@@ -1,7 +1,8 @@
 #pragma once
-#include <iomanip>
+#include <charconv>
+#include <cstring>
 #include <list>
-#include <sstream>
+#include <memory>
 #include <string>
 
 #include "defs.hpp"
@@ -10,52 +11,162 @@
 namespace orderbook {
 
 typedef std::list<std::string> results_t;
+
+// an unformatted output line, so formatting can be done off the matching thread
+struct result_rec {
+    enum kind_t : uint8_t { FILL, CXL, ERR, ORDER, EOL, END };
+    kind_t kind{};
+    side_t side{UNKNOWN};
+    qty_t qty{};
+    uint32_t oid{};
+    sym_t sym{};
+    price_t prc{};
+    std::unique_ptr<std::string> msg;  // ERR only
+};
+
+// the formatting of the output lines, appended to out with a trailing '\n'
+inline void append_uint(std::string& out, uint64_t v) {
+    char buf[20];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr);
+}
+inline void append_prc(std::string& out, price_t p, int digits = 5) {
+    const double prc_multiplier = 1. / PRC_MULTIPLIER;
+    char buf[64];
+    auto res = std::to_chars(buf, buf + sizeof(buf), p * prc_multiplier,
+        std::chars_format::fixed, digits);
+    out.append(buf, res.ptr);
+}
+inline void append_sym(std::string& out, const sym_t& sym) {
+    out.append(sym.data(), strnlen(sym.data(), sym.size()));
+}
+inline void append_fill(
+    std::string& out, const sym_t& symbol, uint32_t oid, qty_t qty, price_t prc) {
+    out += "F ";
+    append_uint(out, oid);
+    out += ' ';
+    append_sym(out, symbol);
+    out += ' ';
+    append_uint(out, qty);
+    out += ' ';
+    append_prc(out, prc);
+    out += '\n';
+}
+inline void append_order(std::string& out, const sym_t& symbol, uint32_t oid,
+    side_t side, qty_t qty, price_t prc) {
+    out += "P ";
+    append_uint(out, oid);
+    out += ' ';
+    append_sym(out, symbol);
+    out += side == BUY ? " B " : " S ";
+    append_uint(out, qty);
+    out += ' ';
+    append_prc(out, prc);
+    out += '\n';
+}
+
 class output_collector {
  public:
+    // when a sink is set the records are handed to it instead of being
+    // formatted here
+    using sink_fn = void (*)(void* ctx, result_rec&& rec);
+    void set_sink(sink_fn fn, void* ctx) {
+        sink_ = fn;
+        sink_ctx_ = ctx;
+    }
+    bool has_sink() const { return sink_ != nullptr; }
+
     void add_fill(const sym_t& symbol, uint32_t oid, qty_t qty, price_t prc) {
-        std::stringstream ss;
-        ss << "F " << oid << " " << to_string(symbol) << " " << qty << " "
-           << format_prc(prc);
-        results_.push_back(ss.str());
+        add(result_rec{result_rec::FILL, UNKNOWN, qty, oid, symbol, prc, {}});
     }
     void add_cxl(uint32_t oid) {
-        std::stringstream ss;
-        ss << "X " << oid;
-        results_.push_back(ss.str());
+        add(result_rec{result_rec::CXL, UNKNOWN, {}, oid, {}, {}, {}});
     }
     void add_err(const std::string& msg) {
-        std::stringstream ss;
-        ss << "E " << msg;
-        results_.push_back(ss.str());
+        if (sink_) {
+            sink_(sink_ctx_, result_rec{result_rec::ERR, UNKNOWN, {}, {}, {},
+                                 {}, std::make_unique<std::string>(msg)});
+            return;
+        }
+        buf_ += "E ";
+        buf_ += msg;
+        buf_ += '\n';
+        ++lines_;
     }
     void add_order(const sym_t& symbol, uint32_t oid, side_t side, qty_t qty,
         price_t prc) {
-        std::stringstream ss;
-        ss << "P " << oid << " " << to_string(symbol) << " "
-           << (side == BUY ? 'B' : 'S') << " " << qty << " " << format_prc(prc);
-        results_.push_back(ss.str());
+        add(result_rec{result_rec::ORDER, side, qty, oid, symbol, prc, {}});
+    }
+    // lines already formatted by the append_ functions, only without a sink
+    void add_block(const std::string& lines, size_t count) {
+        buf_ += lines;
+        lines_ += count;
+    }
+    // marks the end of the output of one command
+    void end_command() {
+        if (sink_) {
+            result_rec eol;
+            eol.kind = result_rec::EOL;
+            sink_(sink_ctx_, std::move(eol));
+        }
+    }
+
+    void add(result_rec&& rec) {
+        if (sink_) {
+            sink_(sink_ctx_, std::move(rec));
+            return;
+        }
+        switch (rec.kind) {
+            case result_rec::FILL:
+                append_fill(buf_, rec.sym, rec.oid, rec.qty, rec.prc);
+                break;
+            case result_rec::CXL:
+                buf_ += "X ";
+                append_uint(buf_, rec.oid);
+                buf_ += '\n';
+                break;
+            case result_rec::ERR:
+                buf_ += "E ";
+                buf_ += *rec.msg;
+                buf_ += '\n';
+                break;
+            case result_rec::ORDER:
+                append_order(buf_, rec.sym, rec.oid, rec.side, rec.qty, rec.prc);
+                break;
+            default:
+                return;
+        }
+        ++lines_;
     }
     auto retrieve_data() {
         results_t data;
-        std::stringstream ss;
-        ss << "results.size() == " << results_.size();
-        int i = 0;
-        for (auto& line : results_) {
-            ss << "\n\tresults[" << i++ << "] == \"" << line << "\"";
+        std::string out;
+        out.reserve(buf_.size() + lines_ * 24 + 32);
+        out += "results.size() == ";
+        append_uint(out, lines_);
+        size_t i = 0;
+        for (size_t pos = 0; pos < buf_.size();) {
+            auto eol = buf_.find('\n', pos);
+            out += "\n\tresults[";
+            append_uint(out, i++);
+            out += "] == \"";
+            out.append(buf_, pos, eol - pos);
+            out += '"';
+            pos = eol + 1;
         }
-        data.push_back(ss.str());
+        data.push_back(std::move(out));
         return data;
     }
-    void clear() { results_.clear(); }
+    void clear() {
+        buf_.clear();
+        lines_ = 0;
+    }
 
  private:
-    static std::string format_prc(price_t p, int digits = 5) {
-        const double prc_multiplier = 1. / PRC_MULTIPLIER;
-        std::stringstream ss;
-        ss << std::fixed << std::setprecision(digits) << p * prc_multiplier;
-        return ss.str();
-    }
-    results_t results_;
+    std::string buf_;  // the lines, each terminated by '\n'
+    size_t lines_{};
+    sink_fn sink_{};
+    void* sink_ctx_{};
 };
 
 }  // namespace orderbook
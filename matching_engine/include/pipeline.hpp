@@ -0,0 +1,114 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "command.hpp"
+#include "orderbook.hpp"
+#include "spsc_ring.hpp"
+
+namespace orderbook {
+
+// runs parsing, matching and formatting each on its own thread, connected by
+// spsc rings. the output is the same as running the lines one by one
+class pipeline {
+ public:
+    // cpus for the parse, match and format threads. left empty, the threads
+    // are not pinned
+    explicit pipeline(std::vector<int> cpus = {}) : cpus_(std::move(cpus)) {}
+
+    OrderBookMgr& books() { return obm_; }
+
+    void run(std::istream& in, std::ostream& out) {
+        std::thread parser([&]() {
+            setup_thread(0, "sc-parse");
+            parse(in);
+        });
+        std::thread matcher([&]() {
+            setup_thread(1, "sc-match");
+            match();
+        });
+        std::thread formatter([&]() {
+            setup_thread(2, "sc-format");
+            format(out);
+        });
+        parser.join();
+        matcher.join();
+        formatter.join();
+    }
+
+ private:
+    void parse(std::istream& in) {
+        std::string line;
+        while (std::getline(in, line)) {
+            commands_.push(parse_command(line));
+        }
+        command end;
+        end.type = command::END;
+        commands_.push(std::move(end));
+    }
+
+    void match() {
+        log.set_sink(&to_results, this);
+        command cmd;
+        for (;;) {
+            commands_.pop(cmd);
+            if (cmd.type == command::END)
+                break;
+            obm_.execute(cmd);
+            log.end_command();
+        }
+        log.set_sink(nullptr, nullptr);
+        result_rec end;
+        end.kind = result_rec::END;
+        results_.push(std::move(end));
+    }
+
+    void format(std::ostream& out) {
+        output_collector collector;
+        result_rec rec;
+        for (;;) {
+            results_.pop(rec);
+            if (rec.kind == result_rec::END)
+                break;
+            if (rec.kind == result_rec::EOL) {
+                for (auto& data : collector.retrieve_data())
+                    out << data << '\n';
+                collector.clear();
+            } else {
+                collector.add(std::move(rec));
+            }
+        }
+        out.flush();
+    }
+
+    static void to_results(void* ctx, result_rec&& rec) {
+        static_cast<pipeline*>(ctx)->results_.push(std::move(rec));
+    }
+
+    void setup_thread(size_t idx, const char* name) {
+#ifdef __linux__
+        if (!cpus_.empty()) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpus_[idx % cpus_.size()], &cpuset);
+            if (pthread_setaffinity_np(
+                    pthread_self(), sizeof(cpuset), &cpuset) != 0)
+                std::cerr << "failed to pin " << name << std::endl;
+        }
+        pthread_setname_np(pthread_self(), name);
+#endif
+    }
+
+    std::vector<int> cpus_;
+    OrderBookMgr obm_;
+    spsc_ring<command, 4096> commands_;
+    spsc_ring<result_rec, 16384> results_;
+};
+
+}  // namespace orderbook
@@ -0,0 +1,194 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "command.hpp"
+#include "orderbook.hpp"
+#include "spsc_ring.hpp"
+
+namespace orderbook {
+
+// request written by a client, the binary form of command
+struct shm_command {
+    uint64_t seq{};  // assigned by the client, echoed in every response
+    price_t prc{};
+    price_t prc_hi{};  // MASS_CXL only
+    sym_t sym{};
+    uint32_t oid{};
+    qty_t qty{};
+    uint8_t type{};  // command::type_t, END stops the engine
+    uint8_t side{};  // side_t
+};
+
+// one output line of a request. every request is answered by its output
+// records followed by an EOL record, which is the ack
+struct shm_result {
+    uint64_t seq{};
+    price_t prc{};
+    sym_t sym{};
+    uint32_t oid{};
+    qty_t qty{};
+    uint8_t kind{};  // result_rec::kind_t
+    uint8_t side{};
+    char msg[32]{};  // ERR only, truncated and '\0' terminated
+};
+
+static_assert(std::is_trivially_copyable_v<shm_command>);
+static_assert(std::is_trivially_copyable_v<shm_result>);
+static_assert(sizeof(shm_result) == 64);
+static_assert(std::atomic<size_t>::is_always_lock_free,
+    "the rings are shared between processes");
+
+// the layout of the shared memory object
+struct shm_region {
+    static constexpr uint64_t MAGIC = 0x53435f4757590001;  // "SC_GWY" v1
+    std::atomic<uint64_t> magic;  // stored last by the engine
+    spsc_ring<shm_command, 4096> requests;
+    spsc_ring<shm_result, 16384> responses;
+};
+
+// a /dev/shm backed mapping of a shm_region. the engine creates it and
+// unlinks it on destruction, clients open an existing one
+class shm_mapping {
+ public:
+    static shm_mapping create(const std::string& name) {
+        auto path = to_path(name);
+        ::shm_unlink(path.c_str());  // left behind by an engine that died
+        int fd = ::shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+            fail("shm_open " + path);
+        if (::ftruncate(fd, sizeof(shm_region)) != 0) {
+            ::close(fd);
+            ::shm_unlink(path.c_str());
+            fail("ftruncate " + path);
+        }
+        shm_mapping m(path, fd, true);
+        new (m.region_) shm_region();
+        m.region_->magic.store(shm_region::MAGIC, std::memory_order_release);
+        return m;
+    }
+
+    static shm_mapping open(const std::string& name) {
+        auto path = to_path(name);
+        int fd = ::shm_open(path.c_str(), O_RDWR, 0);
+        if (fd < 0)
+            fail("shm_open " + path);
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 ||
+            static_cast<size_t>(st.st_size) < sizeof(shm_region)) {
+            ::close(fd);
+            throw std::runtime_error(path + " is not a gateway region");
+        }
+        shm_mapping m(path, fd, false);
+        spin_until([&]() {
+            return m.region_->magic.load(std::memory_order_acquire) ==
+                   shm_region::MAGIC;
+        });
+        return m;
+    }
+
+    shm_mapping(shm_mapping&& o) noexcept
+        : path_(std::move(o.path_)), region_(o.region_), owner_(o.owner_) {
+        o.region_ = nullptr;
+        o.owner_ = false;
+    }
+    shm_mapping& operator=(shm_mapping&&) = delete;
+    ~shm_mapping() {
+        if (region_)
+            ::munmap(region_, sizeof(shm_region));
+        if (owner_)
+            ::shm_unlink(path_.c_str());
+    }
+
+    shm_region* operator->() const { return region_; }
+
+ private:
+    shm_mapping(std::string path, int fd, bool owner)
+        : path_(std::move(path)), owner_(owner) {
+        void* p = ::mmap(nullptr, sizeof(shm_region), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            if (owner_)
+                ::shm_unlink(path_.c_str());
+            fail("mmap " + path_);
+        }
+        region_ = static_cast<shm_region*>(p);
+    }
+
+    static std::string to_path(const std::string& name) {
+        return name.empty() || name[0] != '/' ? "/" + name : name;
+    }
+    [[noreturn]] static void fail(const std::string& what) {
+        throw std::runtime_error(what + ": " + std::strerror(errno));
+    }
+
+    std::string path_;
+    shm_region* region_{};
+    bool owner_{};
+};
+
+// engine side of the gateway, busy-polls the request ring and feeds the
+// commands to its OrderBookMgr until a client sends END
+class shm_gateway {
+ public:
+    explicit shm_gateway(const std::string& name)
+        : shm_(shm_mapping::create(name)) {}
+
+    OrderBookMgr& books() { return obm_; }
+
+    void run() {
+        log.set_sink(&to_responses, this);
+        shm_command req;
+        for (;;) {
+            shm_->requests.pop(req);
+            seq_ = req.seq;
+            if (req.type == command::END) {
+                log.end_command();
+                break;
+            }
+            obm_.execute(to_command(req));
+            log.end_command();
+        }
+        log.set_sink(nullptr, nullptr);
+    }
+
+ private:
+    static command to_command(const shm_command& req) {
+        return check_command(req.type, req.side, req.qty, req.oid, req.sym,
+            req.prc, req.prc_hi);
+    }
+
+    static void to_responses(void* ctx, result_rec&& rec) {
+        auto* self = static_cast<shm_gateway*>(ctx);
+        shm_result res;
+        res.seq = self->seq_;
+        res.kind = rec.kind;
+        res.side = static_cast<uint8_t>(rec.side);
+        res.qty = rec.qty;
+        res.oid = rec.oid;
+        res.sym = rec.sym;
+        res.prc = rec.prc;
+        if (rec.msg) {
+            auto n = std::min(rec.msg->size(), sizeof(res.msg) - 1);
+            std::memcpy(res.msg, rec.msg->data(), n);
+        }
+        self->shm_->responses.push(std::move(res));
+    }
+
+    shm_mapping shm_;
+    OrderBookMgr obm_;
+    uint64_t seq_{};
+};
+
+}  // namespace orderbook
@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+namespace orderbook {
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// spin for a while, then give the core away, until pred() holds
+template <typename Pred>
+void spin_until(Pred&& pred) {
+    for (uint32_t i = 0; !pred(); ++i) {
+        if (i < 1024)
+            cpu_relax();
+        else
+            std::this_thread::yield();
+    }
+}
+
+// bounded single producer single consumer ring. each side keeps a cached copy
+// of the other side's index, so the shared cache line is only read when the
+// ring looks full (producer) or empty (consumer). the slots are stored inline,
+// so with a trivially copyable T the ring can be placed in shared memory
+template <typename T, size_t N>
+class spsc_ring {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of 2");
+
+ public:
+    spsc_ring() = default;
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    // v is left untouched when the ring is full
+    bool try_push(T&& v) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == N) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == N)
+                return false;
+        }
+        slots_[tail & (N - 1)] = std::move(v);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& v) {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+                return false;
+        }
+        v = std::move(slots_[head & (N - 1)]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T&& v) {
+        spin_until([&]() { return try_push(std::move(v)); });
+    }
+
+    void pop(T& v) {
+        spin_until([&]() { return try_pop(v); });
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+ private:
+    // consumer side
+    alignas(64) std::atomic<size_t> head_{};
+    size_t tail_cache_{};
+    // producer side
+    alignas(64) std::atomic<size_t> tail_{};
+    size_t head_cache_{};
+
+    alignas(64) std::array<T, N> slots_{};
+};
+
+}  // namespace orderbook
@@ -5,8 +5,9 @@
 #include "defs.hpp"
 
 namespace orderbook {
+// a full length symbol has no '\0'
 inline std::string to_string(const sym_t& sym) {
-    return std::string(sym.data());
+    return std::string(sym.data(), strnlen(sym.data(), sym.size()));
 }
 
 inline bool convert_to_double(const std::string& str, double& val) {
@@ -0,0 +1,115 @@
+// converts simple_cross input between the text and the binary format
+//
+//   ./sc_convert bin input.txt output.bin
+//   ./sc_convert text input.bin output.txt
+//   ./sc_convert check [max_prc]
+//
+// lines that parse_command rejects have no binary form and are reported and
+// skipped, as are empty lines. ./simple_cross -b runs the binary file.
+// check converts O and M messages with every fixed point price in
+// [1, max_prc] to text and back and reports the ones that change
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "binary_protocol.hpp"
+
+using namespace orderbook;
+
+static int to_binary(std::istream& in, std::ostream& out) {
+    std::string line;
+    char msg[BIN_MSG_SIZE];
+    size_t n = 0, lineno = 0, skipped = 0;
+    while (std::getline(in, line)) {
+        ++lineno;
+        if (line.empty())
+            continue;
+        auto cmd = parse_command(line);
+        if (!encode_command(cmd, msg)) {
+            std::fprintf(stderr, "line %zu: %s\n", lineno,
+                cmd.err ? cmd.err->c_str() : line.c_str());
+            ++skipped;
+            continue;
+        }
+        out.write(msg, sizeof(msg));
+        ++n;
+    }
+    std::fprintf(stderr, "%zu messages, %zu lines skipped\n", n, skipped);
+    return out ? 0 : 1;
+}
+
+static int to_text(std::istream& in, std::ostream& out) {
+    char msg[BIN_MSG_SIZE];
+    size_t n = 0, skipped = 0;
+    while (in.read(msg, sizeof(msg))) {
+        auto cmd = decode_command(msg);
+        auto line = format_command(cmd);
+        if (line.empty()) {
+            std::fprintf(stderr, "message %zu: %s\n", n + skipped,
+                cmd.err ? cmd.err->c_str() : "no text form");
+            ++skipped;
+            continue;
+        }
+        out << line << '\n';
+        ++n;
+    }
+    if (in.gcount() != 0)
+        std::fprintf(stderr, "input ends inside a message\n");
+    std::fprintf(stderr, "%zu lines, %zu messages skipped\n", n, skipped);
+    return out && in.gcount() == 0 ? 0 : 1;
+}
+
+static int check_round_trip(price_t max_prc) {
+    char msg[BIN_MSG_SIZE], back[BIN_MSG_SIZE];
+    command add, mass;
+    add.type = command::ADD;
+    add.side = SELL;
+    add.qty = 1;
+    add.oid = 1;
+    add.sym = {'I', 'B', 'M'};
+    mass.type = command::MASS_CXL;
+    mass.side = BUY;
+    mass.sym = add.sym;
+    size_t n = 0, changed = 0;
+    auto round_trip = [&](const command& cmd) {
+        encode_command(cmd, msg);
+        auto line = format_command(decode_command(msg));
+        ++n;
+        if (encode_command(parse_command(line), back) &&
+            std::equal(msg, msg + BIN_MSG_SIZE, back))
+            return;
+        if (changed++ < 10)
+            std::fprintf(stderr, "prc %llu: %s\n",
+                static_cast<unsigned long long>(cmd.prc), line.c_str());
+    };
+    for (price_t prc = 1; prc <= max_prc; ++prc) {
+        add.prc = prc;
+        round_trip(add);
+        mass.prc = prc;
+        mass.prc_hi = prc + prc / 2;
+        round_trip(mass);
+    }
+    std::fprintf(stderr, "%zu messages, %zu changed\n", n, changed);
+    return changed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "check" && argc <= 3)
+        return check_round_trip(argc == 3 ? std::stoull(argv[2]) : 1000000);
+    if ((mode != "bin" && mode != "text") || argc != 4) {
+        std::printf("Usage: ./sc_convert bin input.txt output.bin\n"
+                    "       ./sc_convert text input.bin output.txt\n"
+                    "       ./sc_convert check [max_prc]\n");
+        return 0;
+    }
+    bool binary = mode == "bin";
+    std::ifstream in(argv[2], binary ? std::ios::in : std::ios::binary);
+    std::ofstream out(argv[3], binary ? std::ios::binary : std::ios::out);
+    if (!in || !out) {
+        std::fprintf(stderr, "cannot open %s\n", !in ? argv[2] : argv[3]);
+        return 1;
+    }
+    return binary ? to_binary(in, out) : to_text(in, out);
+}
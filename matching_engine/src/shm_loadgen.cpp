@@ -0,0 +1,143 @@
+// load generator for the shared memory gateway
+//
+//   ./simple_cross --shm sc_gateway &
+//   ./shm_loadgen sc_gateway [requests] [--stop]
+//
+// sends random orders, cancels and the occasional mass cancel of a symbol
+// over a few symbols as fast as the request
+// ring takes them and reports the throughput and the send to ack latency.
+// --stop shuts the engine down afterwards
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gateway_client.hpp"
+
+using namespace orderbook;
+using clock_type = std::chrono::steady_clock;
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock_type::now().time_since_epoch())
+        .count();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::printf("Usage: ./shm_loadgen name [requests] [--stop]\n");
+        return 0;
+    }
+    std::string name = argv[1];
+    size_t requests = 1000000;
+    bool stop = false;
+    for (int i = 2; i < argc; ++i) {
+        if (std::string(argv[i]) == "--stop")
+            stop = true;
+        else
+            requests = std::stoul(argv[i]);
+    }
+
+    gateway_client client(name);
+
+    std::vector<sym_t> syms;
+    for (const char* s : {"IBM", "AAPL", "MSFT", "GOOG", "TSLA"}) {
+        sym_t sym{};
+        std::copy_n(s, std::strlen(s), sym.begin());
+        syms.push_back(sym);
+    }
+    std::mt19937 rng(42);
+    std::vector<uint32_t> live;
+    std::vector<uint64_t> sent_ns(requests + 2);  // by seq
+    std::vector<uint64_t> latency_ns;
+    latency_ns.reserve(requests);
+    size_t fills = 0, cxls = 0, errs = 0;
+    uint32_t next_oid = 1;
+
+    auto on_result = [&](const shm_result& res) {
+        switch (res.kind) {
+            case result_rec::FILL:
+                ++fills;
+                break;
+            case result_rec::CXL:
+                ++cxls;
+                break;
+            case result_rec::ERR:
+                ++errs;
+                break;
+            case result_rec::EOL:
+                if (res.seq < sent_ns.size() && sent_ns[res.seq])
+                    latency_ns.push_back(now_ns() - sent_ns[res.seq]);
+                break;
+            default:
+                break;
+        }
+    };
+
+    auto start = clock_type::now();
+    for (size_t i = 0; i < requests; ++i) {
+        if (rng() % 1000 == 0) {
+            // the acked live orders are not tracked, a later cancel of one of
+            // them just comes back as an error
+            auto& sym = syms[rng() % syms.size()];
+            uint64_t seq;
+            while (!(seq = client.mass_cxl(sym)))
+                client.poll(on_result);
+            sent_ns[seq] = now_ns();
+            continue;
+        }
+        bool cancel = !live.empty() && rng() % 4 == 0;
+        uint32_t oid = 0;
+        if (cancel) {
+            auto idx = rng() % live.size();
+            oid = live[idx];
+            live[idx] = live.back();
+            live.pop_back();
+        } else {
+            oid = next_oid++;
+            live.push_back(oid);
+        }
+        auto side = rng() % 2 ? BUY : SELL;
+        auto qty = static_cast<qty_t>(1 + rng() % 50);
+        auto prc = static_cast<price_t>(9900 + rng() % 200) * PRC_MULTIPLIER / 100;
+        auto& sym = syms[rng() % syms.size()];
+        for (;;) {
+            auto t = now_ns();
+            auto seq = cancel ? client.cxl_order(oid)
+                              : client.add_order(oid, sym, side, qty, prc);
+            if (seq) {
+                sent_ns[seq] = t;
+                break;
+            }
+            client.poll(on_result);
+        }
+        client.poll(on_result);
+    }
+    while (latency_ns.size() < requests)
+        if (!client.poll(on_result))
+            cpu_relax();
+    auto secs = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    if (stop) {
+        while (!client.stop_engine())
+            client.poll(on_result);
+    }
+
+    std::sort(latency_ns.begin(), latency_ns.end());
+    auto pct = [&](double p) {
+        return latency_ns[std::min(latency_ns.size() - 1,
+            static_cast<size_t>(p * latency_ns.size()))];
+    };
+    std::printf("requests %zu in %.3f s, %.0f req/s\n", requests, secs,
+        requests / secs);
+    std::printf("fills %zu cancels %zu errors %zu\n", fills, cxls, errs);
+    if (!latency_ns.empty())
+        std::printf("ack latency ns p50 %" PRIu64 " p99 %" PRIu64
+                    " p999 %" PRIu64 " max %" PRIu64 "\n",
+            pct(0.5), pct(0.99), pct(0.999), latency_ns.back());
+    return 0;
+}
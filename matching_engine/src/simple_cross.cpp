@@ -1,9 +1,14 @@
 
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <list>
 
+#include "binary_protocol.hpp"
 #include "orderbook.hpp"
+#include "md_publisher.hpp"
+#include "pipeline.hpp"
+#include "shm_gateway.hpp"
 
 namespace orderbook {
 
@@ -15,82 +20,188 @@ class SimpleCross {
         return log.retrieve_data();
     }
 
+    OrderBookMgr& books() { return obm_; }
+
  private:
     OrderBookMgr obm_;
 
-    static auto split_str_by_delim(const std::string& str, const char delim) {
-        std::vector<std::string> result;
-        size_t start = 0;
-        auto end = str.find(delim);
-        while (end != std::string::npos) {
-            result.push_back(str.substr(start, end - start));
-            start = end + 1;
-            end = str.find(delim, start);
-        }
-        result.push_back(str.substr(start));
-        return result;
+    void parse_and_execute(const std::string& line) {
+        obm_.execute(parse_command(line));
     }
+};
 
-    void parse_and_execute(const std::string& line) {
-        auto tokens = split_str_by_delim(line, ' ');
-        if (tokens.empty())
-            return;
-        if (tokens[0] == "O") {
-            if (tokens.size() != 6) {
-                log.add_err(tokens[1] + " Invalid number of arguments");
-                return;
-            }
-            auto side = tokens[3] == "B" ? side_t::BUY
-                                         : (tokens[3] == "S" ? side_t::SELL
-                                                             : side_t::UNKNOWN);
-            if (side == UNKNOWN) {
-                log.add_err(tokens[1] + " Invalid side: " + tokens[3]);
-                return;
-            }
-            int32_t qty{};
-            if (!convert_to_int(tokens[4], qty) || qty <= 0) {
-                log.add_err(tokens[1] + " Invalid qty: " + tokens[4]);
-                return;
-            }
-            double prc{};
-            if (!convert_to_double(tokens[5], prc) || prc <= 0) {
-                log.add_err(tokens[1] + " Invalid prc: " + tokens[5]);
-                return;
-            }
+}  // namespace orderbook
 
-            auto oid = std::stoi(tokens[1]);
-            sym_t symbol;
-            symbol.fill(0);
-            std::copy(tokens[2].begin(), tokens[2].end(), symbol.begin());
+static std::vector<int> parse_cpus(const std::string& arg) {
+    std::vector<int> cpus;
+    for (auto& cpu : orderbook::split_str_by_delim(arg, ','))
+        cpus.push_back(std::stoi(cpu));
+    return cpus;
+}
+
+// one line per published delta:
+// M sym bid_prc bid_qty ask_prc ask_qty commands [B|S prc qty]...
+// with the changed levels bids first, then asks, each by price
+static void write_delta(std::ostream& out, const orderbook::book_delta& d) {
+    char buf[64];
+    auto prc = [&](orderbook::price_t p) {
+        std::snprintf(buf, sizeof(buf), "%.5f",
+            static_cast<double>(p) / orderbook::PRC_MULTIPLIER);
+        return buf;
+    };
+    out << "M " << orderbook::to_string(d.sym) << " " << prc(d.bid_prc) << " "
+        << d.bid_qty << " " << prc(d.ask_prc) << " " << d.ask_qty << " "
+        << d.commands;
+    for (auto& lvl : d.levels)
+        out << " " << (lvl.side == orderbook::BUY ? 'B' : 'S') << " "
+            << prc(lvl.prc) << " " << lvl.qty;
+    out << '\n';
+}
+
+static void write_pool(
+    std::ostream& out, const char* name, const obj_pool_stats& st) {
+    out << name << " pool " << st.bytes << " bytes, " << st.in_use << "/"
+        << st.objects << " in use in " << st.slabs << " slabs, high water "
+        << st.high_water << '\n';
+}
+
+static void write_memory(
+    std::ostream& out, const orderbook::OrderBookMgr::memory_report& mem) {
+    size_t book_bytes = 0;
+    for (auto& book : mem.books)
+        book_bytes += book.bytes;
+    out << "memory " << mem.total_bytes() << " bytes: " << mem.books.size()
+        << " books " << book_bytes << ", book index " << mem.book_index_bytes
+        << ", order index " << mem.order_index_bytes << ", snapshot buffers "
+        << mem.snapshot_bytes << '\n';
+    write_pool(out, "order", mem.order_pool);
+    write_pool(out, "level", mem.level_pool);
+}
 
-            obm_.add_order(static_cast<uint32_t>(oid), symbol, side,
-                static_cast<qty_t>(qty),
-                static_cast<price_t>(prc * PRC_MULTIPLIER));
-        } else if (tokens[0] == "X") {
-            if (tokens.size() != 2) {
-                log.add_err(tokens[1] + " Invalid number of arguments");
-                return;
-            }
-            auto oid = static_cast<uint32_t>(std::stoi(tokens[1]));
-            obm_.cxl_order(oid);
-        } else if (tokens[0] == "P") {
-            obm_.print_books();
+// ./simple_cross [-p [cpu,cpu,cpu] | -t threads] [--md md_file] input_file
+// -p runs parse, match and format on three threads, optionally pinned
+// ./simple_cross -b [-t threads] [--md md_file] input_file
+// reads binary messages (see binary_protocol.hpp) instead of text lines
+// ./simple_cross [--md md_file] --shm name
+// serves clients through the shared memory gateway /dev/shm/name
+// -t formats large P snapshots on that many extra threads. -p and --shm
+// format P on their consumer side from per-order records, so -t has
+// nothing to do there and is rejected
+// --md publishes conflated book updates to md_file
+// --mem reports the engine's memory on exit, before and after a trim
+// --evict N drops the books left empty and unchanged for N commands, checked
+// every N commands, and reports how many on exit
+int main(int argc, char** argv) {
+    bool pipelined = false;
+    bool binary = false;
+    std::vector<int> cpus;
+    std::string shm_name, md_path;
+    size_t snapshot_threads = 0;
+    uint64_t evict_after = 0;
+    bool mem_report = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+        std::string opt = argv[arg];
+        if (opt == "-p") {
+            pipelined = true;
+            if (arg + 1 < argc - 1 &&
+                std::string(argv[arg + 1]).find_first_not_of("0123456789,") ==
+                    std::string::npos)
+                cpus = parse_cpus(argv[++arg]);
+        } else if (opt == "-b") {
+            binary = true;
+        } else if (opt == "--shm" && arg + 1 < argc) {
+            shm_name = argv[++arg];
+        } else if (opt == "--mem") {
+            mem_report = true;
+        } else if (opt == "-t" && arg + 1 < argc) {
+            snapshot_threads = std::stoul(argv[++arg]);
+        } else if (opt == "--evict" && arg + 1 < argc) {
+            evict_after = std::stoull(argv[++arg]);
+        } else if (opt == "--md" && arg + 1 < argc) {
+            md_path = argv[++arg];
         } else {
-            log.add_err(tokens[0] + " Invalid action");
+            break;
         }
     }
-};
+    if ((shm_name.empty() ? arg != argc - 1 : arg != argc) ||
+        (binary && (pipelined || !shm_name.empty())) ||
+        (snapshot_threads && (pipelined || !shm_name.empty()))) {
+        std::cout << "Usage: ./simple_cross [-p [cpu,cpu,cpu] | -t threads] "
+                     "[--md md_file] [--mem] [--evict N] [input_file]"
+                  << std::endl
+                  << "       ./simple_cross -b [-t threads] [--md md_file] "
+                     "[--mem] [--evict N] [input_file]"
+                  << std::endl
+                  << "       ./simple_cross [--md md_file] [--mem] [--evict N] "
+                     "--shm name"
+                  << std::endl;
+        return 0;
+    }
 
-}  // namespace orderbook
+    std::ofstream md_out;
+    std::unique_ptr<orderbook::md_publisher> md;
+    auto setup_books = [&](orderbook::OrderBookMgr& books) {
+        books.set_snapshot_threads(snapshot_threads);
+        books.set_auto_evict(evict_after);
+        if (md_path.empty())
+            return;
+        md_out.open(md_path);
+        md = std::make_unique<orderbook::md_publisher>(
+            [&md_out](const orderbook::book_delta& d) { write_delta(md_out, d); });
+        md->attach(books);
+        md->start();
+    };
+    auto report = [&](orderbook::OrderBookMgr& books) {
+        if (evict_after)
+            std::cerr << "evicted " << books.evicted() << " books, "
+                      << books.book_count() << " left" << std::endl;
+        if (mem_report) {
+            write_memory(std::cerr, books.memory());
+            std::cerr << "trim released " << books.trim() << " bytes\n";
+            write_memory(std::cerr, books.memory());
+        }
+        if (!md)
+            return;
+        md->stop();
+        std::cerr << "md published " << md->published() << " conflated "
+                  << md->conflated() << std::endl;
+    };
 
-int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cout << "Usage: ./simple_cross [input_file]" << std::endl;
+    if (!shm_name.empty()) {
+        orderbook::shm_gateway gateway(shm_name);
+        setup_books(gateway.books());
+        gateway.run();
+        report(gateway.books());
+        return 0;
+    }
+    if (binary) {
+        std::ifstream in(argv[arg], std::ios::in | std::ios::binary);
+        orderbook::SimpleCross scross;
+        setup_books(scross.books());
+        orderbook::binary_dispatcher dispatcher(scross.books());
+        bool whole = dispatcher.run(in, []() {
+            for (auto& line : orderbook::log.retrieve_data())
+                std::cout << line << std::endl;
+            orderbook::log.clear();
+        });
+        if (!whole)
+            std::cerr << "input ends inside a message" << std::endl;
+        report(scross.books());
+        return 0;
+    }
+    std::ifstream actions(argv[arg], std::ios::in);
+    if (pipelined) {
+        // the rings are too large for the stack
+        auto pipe = std::make_unique<orderbook::pipeline>(std::move(cpus));
+        setup_books(pipe->books());
+        pipe->run(actions, std::cout);
+        report(pipe->books());
         return 0;
     }
     orderbook::SimpleCross scross;
+    setup_books(scross.books());
     std::string line;
-    std::ifstream actions(argv[1], std::ios::in);
     while (std::getline(actions, line)) {
         orderbook::results_t results = scross.action(line);
         for (orderbook::results_t::const_iterator it = results.begin();
@@ -98,5 +209,6 @@ int main(int argc, char** argv) {
             std::cout << *it << std::endl;
         }
     }
+    report(scross.books());
     return 0;
 }
@@ -0,0 +1,159 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <typeinfo>
+#include <type_traits>
+#include <utility>
+
+// values of trivially copyable (hence trivially relocatable) types up to BufSize bytes are stored inline,
+// everything else is heap allocated. either way moving an any is just copying the storage bytes
+template <size_t BufSize = 2 * sizeof(void*)>
+class basic_any {
+private:
+    union storage {
+        void* heap;
+        alignas(std::max_align_t) unsigned char buf[BufSize];
+    };
+
+    template <typename T>
+    static constexpr bool fits_inline = sizeof(T) <= BufSize && alignof(T) <= alignof(std::max_align_t) &&
+        std::is_trivially_copyable_v<T>;
+
+    // one static table per type instead of a vtable per object. its address identifies the type
+    struct ops_t {
+        const std::type_info& (*type)();
+        void (*copy)(const storage& src, storage& dst);
+        void (*destroy)(storage&) noexcept;  // nullptr for inline values, they are trivially destructible
+    };
+
+    template <typename T>
+    static constexpr ops_t ops_for{
+        []() -> const std::type_info& { return typeid(T); },
+        [](const storage& src, storage& dst) {
+            if constexpr (fits_inline<T>)
+                std::memcpy(dst.buf, src.buf, sizeof(T));
+            else
+                dst.heap = new T(*static_cast<const T*>(src.heap));
+        },
+        fits_inline<T> ? nullptr : +[](storage& s) noexcept { delete static_cast<T*>(s.heap); },
+    };
+
+    template <typename T>
+    T* ptr() {
+        if constexpr (fits_inline<T>)
+            return std::launder(reinterpret_cast<T*>(data.buf));
+        else
+            return static_cast<T*>(data.heap);
+    }
+    template <typename T>
+    const T* ptr() const {
+        return const_cast<basic_any*>(this)->ptr<T>();
+    }
+
+    template <typename T, typename... Args>
+    T& construct(Args&&... args) {
+        T* p;
+        if constexpr (fits_inline<T>)
+            p = new (data.buf) T(std::forward<Args>(args)...);
+        else
+            data.heap = p = new T(std::forward<Args>(args)...);
+        ops = &ops_for<T>;
+        return *p;
+    }
+
+    storage data;
+    const ops_t* ops{};
+
+public:
+    basic_any() = default;
+
+    // without this condition, infinite recursion will happen when an any object is constructed with another any object
+    template<typename T, typename = typename std::enable_if_t<!std::is_same_v<typename std::decay_t<T>, basic_any>>>
+    basic_any(T&& value) {
+        construct<std::decay_t<T>>(std::forward<T>(value));
+    }
+
+    // copy constructor
+    basic_any(const basic_any& other) {
+        if (other.ops) {
+            other.ops->copy(other.data, data);
+            ops = other.ops;
+        }
+    }
+    basic_any& operator=(const basic_any& other) {
+        if (this == &other)
+            return *this;
+        basic_any tmp(other);
+        return *this = std::move(tmp);
+    }
+
+    // move constructor: inline values are trivially relocatable and heap values are a pointer, copying bytes covers both
+    basic_any(basic_any&& other) noexcept : data(other.data), ops(std::exchange(other.ops, nullptr)) {}
+    basic_any& operator=(basic_any&& other) noexcept {
+        if (this == &other)
+            return *this;
+        reset();
+        data = other.data;
+        ops = std::exchange(other.ops, nullptr);
+        return *this;
+    }
+
+    ~basic_any() {
+        reset();
+    }
+
+    void reset() {
+        if (ops && ops->destroy)
+            ops->destroy(data);
+        ops = nullptr;
+    }
+
+    // constructs the value in place, no temporary
+    template<typename T, typename... Args>
+    std::decay_t<T>& emplace(Args&&... args) {
+        reset();
+        return construct<std::decay_t<T>>(std::forward<Args>(args)...);
+    }
+
+    bool has_value() const {
+        return ops != nullptr;
+    }
+
+    const std::type_info& type() const {
+        return has_value() ? ops->type() : typeid(void);
+    }
+
+    template<typename T>
+    bool is() const {
+        return ops == &ops_for<T>;  // a pointer comparison, no type_info involved
+    }
+
+    template<typename T>
+    T& as() {
+        if(!is<T>())
+            throw std::bad_cast();
+        return *ptr<T>();
+    }
+
+    template<typename T>
+    const T& as() const {
+        if(!is<T>())
+            throw std::bad_cast();
+        return *ptr<T>();
+    }
+
+    // no type check at all, the caller must know the any holds a T
+    template<typename T>
+    T& as_unchecked() {
+        return *ptr<T>();
+    }
+
+    template<typename T>
+    const T& as_unchecked() const {
+        return *ptr<T>();
+    }
+};
+
+using any = basic_any<>;
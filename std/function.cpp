@@ -1,44 +1,47 @@
 #include <iostream>
+#include <chrono>
+#include <functional>  // std::function to benchmark against
+#include <string>
 
-template <typename>
-class function;
+#include "function.hpp"
 
-template <typename Ret, typename... Args>
-class function<Ret(Args...)> {
-private:
-    struct Base {
-        virtual ~Base() {}
-        virtual Ret operator()(Args&&...) = 0;
-    };
-
-    template <typename T>
-    struct Wrapper : Base {
-        T func;
-        Wrapper(const T& f) : func(f) {}
-        Ret operator()(Args&&... args) override {
-            return func(args...);
-        }
-    };
-
-    std::unique_ptr<Base> func_holder;  // polymorphism is needed
-public:
-    function() = default;
-
-    template <typename T>
-    function(T f) : func_holder(new Wrapper<T>(f)) {}  // does the dynamic allocation. captured data are memebers of struct T
-
-    Ret operator()(Args&&... args) {
-        if (!func_holder) {
-            throw std::bad_function_call();
-        }
-        return (*func_holder)(std::forward<Args>(args)...);
-    }
-};
 void execute(function<int(int, int)> f) {
     std::cout << f(1,2) << std::endl;;
 }
+
+template <typename F, typename Make>
+double bench_ns(Make make, int iters) {
+    volatile int sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) {
+        F f = make(i);
+        F g = f;  // copy
+        F h = std::move(g);
+        sink = sink ^ h(i, 1);
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / iters;
+}
+
 int main() {
     int x = 20;
     auto f = [x](int a, int b) {return a+b+x;};
     execute(f);
-}
\ No newline at end of file
+
+    int a = 1;
+    function<int(int, int)> g = f;
+    auto h = g;  // copyable now
+    std::cout << h(a, a) << std::endl;  // lvalue arguments
+
+    // construct + copy + move + invoke, against std::function
+    const int iters = 1000000;
+    auto captureless = [](int) { return [](int a, int b) { return a + b; }; };
+    auto small = [](int i) { return [i](int a, int b) { return a + b + i; }; };
+    auto large = [](int i) { return [i, s = std::string(64, 'x')](int a, int b) { return a + b + i + int(s.size()); }; };
+    std::cout << "captureless: function " << bench_ns<function<int(int, int)>>(captureless, iters)
+              << "ns, std::function " << bench_ns<std::function<int(int, int)>>(captureless, iters) << "ns" << std::endl;
+    std::cout << "small capture: function " << bench_ns<function<int(int, int)>>(small, iters)
+              << "ns, std::function " << bench_ns<std::function<int(int, int)>>(small, iters) << "ns" << std::endl;
+    std::cout << "large capture: function " << bench_ns<function<int(int, int)>>(large, iters)
+              << "ns, std::function " << bench_ns<std::function<int(int, int)>>(large, iters) << "ns" << std::endl;
+}
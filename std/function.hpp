@@ -0,0 +1,153 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <functional>  // std::bad_function_call, std::invoke
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// callables that fit in BufSize bytes are stored inline, larger ones go to the heap and buf_ holds the pointer.
+// the default matches libstdc++, so function is 4 pointers wide
+template <typename, size_t BufSize = 2 * sizeof(void*)>
+class function;
+
+template <typename Ret, typename... Args, size_t BufSize>
+class function<Ret(Args...), BufSize> {
+private:
+    static_assert(BufSize >= sizeof(void*), "buf_ must hold at least the heap pointer");
+
+    enum class op { copy, move, destroy };
+    using invoke_fn = Ret (*)(void*, Args&&...);
+    using manage_fn = void (*)(op, void* dst, void* src);
+
+    // moving an inline callable must not throw, otherwise function's move ctor can't be noexcept
+    template <typename T>
+    static constexpr bool fits_inline = sizeof(T) <= BufSize &&
+        alignof(T) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<T>;
+
+    // inline and trivially copyable: copy and move are a memcpy of buf_ and there is nothing to destroy,
+    // so no manager is stored at all
+    template <typename T>
+    static constexpr bool is_trivial = fits_inline<T> && std::is_trivially_copyable_v<T>;
+
+    template <typename T>
+    static T& get(void* buf) {
+        if constexpr (fits_inline<T>)
+            return *static_cast<T*>(buf);
+        else
+            return **static_cast<T**>(buf);
+    }
+
+    // one plain function pointer for the call, one for the lifetime operations, no vtable
+    template <typename T>
+    static Ret invoke(void* buf, Args&&... args) {
+        return std::invoke(get<T>(buf), std::forward<Args>(args)...);
+    }
+    template <typename T>
+    static void manage(op o, void* dst, void* src) {
+        switch (o) {
+        case op::copy:
+            if constexpr (fits_inline<T>)
+                new (dst) T(get<T>(src));
+            else
+                *static_cast<T**>(dst) = new T(get<T>(src));
+            break;
+        case op::move:
+            if constexpr (fits_inline<T>) {
+                new (dst) T(std::move(get<T>(src)));
+                get<T>(src).~T();
+            } else {
+                *static_cast<T**>(dst) = *static_cast<T**>(src);  // just steal the heap object
+            }
+            break;
+        case op::destroy:
+            if constexpr (fits_inline<T>)
+                get<T>(dst).~T();
+            else
+                delete &get<T>(dst);
+            break;
+        }
+    }
+
+    template <typename T, typename U>
+    void make(U&& f) {
+        if constexpr (fits_inline<T>)
+            new (&buf_) T(std::forward<U>(f));  // captured data live in buf_, no allocation
+        else
+            *reinterpret_cast<T**>(&buf_) = new T(std::forward<U>(f));
+        invoke_ = &invoke<T>;
+        if constexpr (!is_trivial<T>)
+            manage_ = &manage<T>;
+    }
+
+    void reset() {
+        if (manage_)
+            manage_(op::destroy, &buf_, nullptr);
+        invoke_ = nullptr;
+        manage_ = nullptr;
+    }
+
+    void move_from(function& other) noexcept {
+        if (other.manage_)
+            other.manage_(op::move, &buf_, &other.buf_);
+        else
+            std::memcpy(&buf_, &other.buf_, BufSize);
+        invoke_ = std::exchange(other.invoke_, nullptr);
+        manage_ = std::exchange(other.manage_, nullptr);
+    }
+
+    alignas(std::max_align_t) unsigned char buf_[BufSize];
+    invoke_fn invoke_{};  // null when empty
+    manage_fn manage_{};  // null when empty or when the callable is trivial
+public:
+    function() = default;
+
+    // only callables invocable as Ret(Args...), so overloads taking different function types resolve correctly
+    template <typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, function> &&
+        std::is_invocable_r_v<Ret, std::decay_t<T>&, Args...>>>
+    function(T&& f) {
+        make<std::decay_t<T>>(std::forward<T>(f));
+    }
+
+    function(const function& other) {
+        if (other.manage_)
+            other.manage_(op::copy, &buf_, const_cast<unsigned char*>(other.buf_));
+        else
+            std::memcpy(&buf_, &other.buf_, BufSize);
+        invoke_ = other.invoke_;
+        manage_ = other.manage_;
+    }
+    function& operator=(const function& other) {
+        if (this != &other) {
+            function tmp(other);  // copy first so we stay intact if it throws
+            reset();
+            move_from(tmp);
+        }
+        return *this;
+    }
+
+    function(function&& other) noexcept {
+        move_from(other);
+    }
+    function& operator=(function&& other) noexcept {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    ~function() {
+        reset();
+    }
+
+    explicit operator bool() const { return invoke_ != nullptr; }
+
+    // Args are taken as declared, so lvalues bind and forwarding refs are passed through untouched
+    Ret operator()(Args... args) const {
+        if (!invoke_) {
+            throw std::bad_function_call();
+        }
+        return invoke_(const_cast<unsigned char*>(buf_), std::forward<Args>(args)...);
+    }
+};
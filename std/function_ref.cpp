@@ -0,0 +1,23 @@
+#include <iostream>
+#include <iterator>
+
+#include "function_ref.hpp"
+
+int twice(int v) { return 2 * v; }
+
+// callback passed down the stack, no type erasure storage
+int sum_transformed(const int* begin, const int* end, function_ref<int(int)> fn) {
+    int sum = 0;
+    for (; begin != end; ++begin)
+        sum += fn(*begin);
+    return sum;
+}
+
+int main() {
+    int data[] = {1, 2, 3, 4};
+    int offset = 10;
+    auto add_offset = [offset](int v) { return v + offset; };
+    std::cout << sum_transformed(std::begin(data), std::end(data), add_offset) << std::endl;
+    std::cout << sum_transformed(std::begin(data), std::end(data), twice) << std::endl;
+    std::cout << sum_transformed(std::begin(data), std::end(data), [](int v) { return v * v; }) << std::endl;
+}
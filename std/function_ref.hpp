@@ -0,0 +1,48 @@
+#pragma once
+#include <functional>  // std::invoke
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+template <typename>
+class function_ref;
+
+// non-owning view of a callable: one pointer to the callable and one plain function pointer to call it.
+// it doesn't extend the callable's lifetime, so use it for parameters and never store it
+template <typename Ret, typename... Args>
+class function_ref<Ret(Args...)> {
+private:
+    union storage {
+        void* obj;
+        Ret (*fn)(Args...);
+    };
+    using invoke_fn = Ret (*)(storage, Args&&...);
+
+    storage obj_{};
+    invoke_fn invoke_{};
+public:
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, function_ref> &&
+                                                      std::is_invocable_r_v<Ret, F&, Args...>>>
+    function_ref(F&& f) {
+        if constexpr (std::is_pointer_v<std::decay_t<F>> && std::is_function_v<std::remove_pointer_t<std::decay_t<F>>>) {
+            obj_.fn = f;  // function pointers can't portably round-trip through void*
+            invoke_ = [](storage s, Args&&... args) -> Ret {
+                return s.fn(std::forward<Args>(args)...);
+            };
+        } else {
+            obj_.obj = const_cast<void*>(static_cast<const void*>(std::addressof(f)));
+            invoke_ = [](storage s, Args&&... args) -> Ret {
+                return std::invoke(*static_cast<std::remove_reference_t<F>*>(s.obj), std::forward<Args>(args)...);
+            };
+        }
+    }
+
+    function_ref(const function_ref&) = default;
+    function_ref& operator=(const function_ref&) = default;
+
+    Ret operator()(Args... args) const {
+        return invoke_(obj_, std::forward<Args>(args)...);
+    }
+};
+
+static_assert(sizeof(function_ref<void()>) == 2 * sizeof(void*));
@@ -0,0 +1,36 @@
+#include <iostream>
+#include <array>
+#include <string>
+#include <type_traits>
+
+#include "inplace_function.hpp"
+
+static_assert(std::is_nothrow_move_constructible_v<inplace_function<void(int)>>);
+
+// a pooled object carrying its own callback, no allocation anywhere
+struct timer_slot {
+    int id{};
+    inplace_function<void(int), 16> on_fire;
+};
+
+int main() {
+    std::array<timer_slot, 4> ring{};
+    int fired = 0;
+    for (int i = 0; i < 4; ++i) {
+        ring[i].id = i;
+        ring[i].on_fire = [&fired, i](int id) { fired += id * i; };
+    }
+    for (auto& slot : ring)
+        slot.on_fire(slot.id);
+    std::cout << "fired: " << fired << std::endl;
+
+    inplace_function<std::string(const std::string&)> greet = [prefix = std::string("hello ")](const std::string& who) {
+        return prefix + who;
+    };
+    auto copy = greet;
+    std::cout << copy("world") << std::endl;
+
+    // does not compile: 64 bytes of capture in a 16 byte inplace_function
+    // std::array<char, 64> big{};
+    // inplace_function<void(int), 16> too_big = [big](int) {};
+}
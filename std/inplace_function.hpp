@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <functional>  // std::bad_function_call, std::invoke
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// fixed capacity callable wrapper: the callable always lives in buf_, oversized ones don't compile.
+// never allocates, so it can sit in ring-buffer slots and pooled objects. moves are noexcept, so containers of
+// inplace_function move them on reallocation instead of copying
+template <typename, size_t Capacity = 4 * sizeof(void*)>
+class inplace_function;
+
+template <typename Ret, typename... Args, size_t Capacity>
+class inplace_function<Ret(Args...), Capacity> {
+private:
+    enum class op { copy, move, destroy };
+    using invoke_fn = Ret (*)(void*, Args&&...);
+    using manage_fn = void (*)(op, void* dst, void* src);
+
+    // one plain function pointer for the call, one for the rare lifetime operations
+    template <typename T>
+    static Ret invoke(void* f, Args&&... args) {
+        return std::invoke(*static_cast<T*>(f), std::forward<Args>(args)...);
+    }
+    template <typename T>
+    static void manage(op o, void* dst, void* src) {
+        switch (o) {
+        case op::copy:
+            new (dst) T(*static_cast<const T*>(src));
+            break;
+        case op::move:
+            new (dst) T(std::move(*static_cast<T*>(src)));
+            static_cast<T*>(src)->~T();
+            break;
+        case op::destroy:
+            static_cast<T*>(dst)->~T();
+            break;
+        }
+    }
+
+    void reset() {
+        if (manage_)
+            manage_(op::destroy, &buf_, nullptr);
+        invoke_ = nullptr;
+        manage_ = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char buf_[Capacity];
+    invoke_fn invoke_{};  // null when empty
+    manage_fn manage_{};  // null when empty or when the callable is trivially copyable, which is copied with memcpy
+public:
+    inplace_function() = default;
+
+    template <typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, inplace_function>>>
+    inplace_function(T&& f) {
+        using F = std::decay_t<T>;
+        static_assert(sizeof(F) <= Capacity, "callable too large for inplace_function, raise Capacity");
+        static_assert(alignof(F) <= alignof(std::max_align_t), "callable over-aligned for inplace_function");
+        static_assert(std::is_copy_constructible_v<F>, "inplace_function requires a copyable callable");
+        static_assert(std::is_nothrow_move_constructible_v<F>, "inplace_function requires a nothrow movable callable");
+        new (&buf_) F(std::forward<T>(f));
+        invoke_ = &invoke<F>;
+        if constexpr (!std::is_trivially_copyable_v<F>)
+            manage_ = &manage<F>;
+    }
+
+    inplace_function(const inplace_function& other) : invoke_(other.invoke_), manage_(other.manage_) {
+        if (manage_)
+            manage_(op::copy, &buf_, const_cast<unsigned char*>(other.buf_));
+        else
+            std::memcpy(&buf_, &other.buf_, Capacity);
+    }
+    inplace_function& operator=(const inplace_function& other) {
+        if (this != &other) {
+            reset();
+            if (other.manage_)
+                other.manage_(op::copy, &buf_, const_cast<unsigned char*>(other.buf_));
+            else
+                std::memcpy(&buf_, &other.buf_, Capacity);
+            invoke_ = other.invoke_;
+            manage_ = other.manage_;
+        }
+        return *this;
+    }
+
+    inplace_function(inplace_function&& other) noexcept : invoke_(other.invoke_), manage_(other.manage_) {
+        if (manage_)
+            manage_(op::move, &buf_, &other.buf_);
+        else
+            std::memcpy(&buf_, &other.buf_, Capacity);
+        other.invoke_ = nullptr;
+        other.manage_ = nullptr;
+    }
+    inplace_function& operator=(inplace_function&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.manage_)
+                other.manage_(op::move, &buf_, &other.buf_);
+            else
+                std::memcpy(&buf_, &other.buf_, Capacity);
+            invoke_ = std::exchange(other.invoke_, nullptr);
+            manage_ = std::exchange(other.manage_, nullptr);
+        }
+        return *this;
+    }
+
+    ~inplace_function() {
+        reset();
+    }
+
+    explicit operator bool() const { return invoke_ != nullptr; }
+
+    Ret operator()(Args... args) const {
+        if (!invoke_) {
+            throw std::bad_function_call();
+        }
+        return invoke_(const_cast<unsigned char*>(buf_), std::forward<Args>(args)...);
+    }
+};
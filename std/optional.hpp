@@ -0,0 +1,184 @@
+#pragma once
+#include <type_traits>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// build with -DOPTIONAL_TRACE to see which constructor or assignment runs, it compiles to nothing otherwise
+#ifdef OPTIONAL_TRACE
+#include <iostream>
+#define OPTIONAL_TRACE_LOG(msg) (std::cout << msg << std::endl)
+#else
+#define OPTIONAL_TRACE_LOG(msg) ((void)0)
+#endif
+
+// copy, move and destruction are trivial whenever they are trivial for T, so optional<int> or optional<Order*>
+// is trivially copyable, passed in registers and safe to memcpy
+template <typename T>
+struct optional {
+private:
+	union { char dummy_; T data_; }; // alternatively, use std::aligned_storage_t, but it's not trivially destructible (POD)
+	bool valid_{};
+
+	static constexpr bool trivial_copy = std::is_trivially_copy_constructible_v<T>;
+	static constexpr bool trivial_move = std::is_trivially_move_constructible_v<T>;
+	static constexpr bool trivial_copy_assign = std::is_trivially_copy_assignable_v<T> && trivial_copy && std::is_trivially_destructible_v<T>;
+	static constexpr bool trivial_move_assign = std::is_trivially_move_assignable_v<T> && trivial_move && std::is_trivially_destructible_v<T>;
+
+	template <typename... Args>
+	void construct(Args&&... args) {
+		// ATTENTION: we cannot do data_=other.data_; because T may have constructors and this doesn't work for Union (eg. string)
+		new (&data_) T(std::forward<Args>(args)...);
+		valid_ = true;
+	}
+
+public:
+	constexpr optional() : dummy_{0}, valid_{} {
+		OPTIONAL_TRACE_LOG("default ctor called");
+	}
+
+	optional(const optional<T>& other) requires trivial_copy = default;
+	optional(const optional<T>& other) requires (!trivial_copy) : dummy_{0}, valid_{} {
+		OPTIONAL_TRACE_LOG("copy ctor called");
+		if (other.valid_)
+			construct(other.data_);  // uses copy ctor
+	}
+
+	optional(optional<T>&& other) requires trivial_move = default;
+	optional(optional<T>&& other) noexcept(std::is_nothrow_move_constructible_v<T>) requires (!trivial_move) : dummy_{0}, valid_{} {
+		OPTIONAL_TRACE_LOG("move ctor called");
+		if (other.valid_)
+			construct(std::move(other.data_));
+	}
+
+	optional<T>& operator=(const optional<T>& other) requires trivial_copy_assign = default;
+	optional<T>& operator=(const optional<T>& other) requires (!trivial_copy_assign) {
+		OPTIONAL_TRACE_LOG("copy assignment called");
+		if (this == &other)
+			return *this;
+		if (valid_ && other.valid_)
+			data_ = other.data_;
+		else if (other.valid_)
+			construct(other.data_);
+		else
+			reset();
+		return *this;
+	}
+
+	optional<T>& operator=(optional<T>&& other) noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>)
+		requires (!trivial_move_assign) {
+		OPTIONAL_TRACE_LOG("move assignment called");
+		if (this == &other)
+			return *this;
+		if (valid_ && other.valid_)
+			data_ = std::move(other.data_);
+		else if (other.valid_)
+			construct(std::move(other.data_));
+		else
+			reset();
+		return *this;
+	}
+	optional<T>& operator=(optional<T>&& other) requires trivial_move_assign = default;
+
+	// from T
+	optional(const T& data) : valid_(true) {
+		OPTIONAL_TRACE_LOG("ctor from const T& called");
+		new (&data_) T(data);
+	}
+	optional(T&& data) : valid_(true) {
+		OPTIONAL_TRACE_LOG("ctor from T&& called");
+		new (&data_)T(std::move(data));
+	}
+
+	optional& operator=(const T& data) {
+		OPTIONAL_TRACE_LOG("operator=(const T&) called");
+		if (valid_ && &data == &data_) {
+			return *this;
+		}
+		reset();
+		construct(data);
+		return *this;
+	}
+
+	template <typename... Args>
+	T& emplace(Args&&... args) {
+		reset();
+		construct(std::forward<Args>(args)...);
+		return data_;
+	}
+
+	void reset() {
+		if (valid_) {
+			data_.~T();
+			valid_ = false;
+		}
+	}
+
+	bool has_value() const { return valid_; }
+	explicit operator bool() const { return valid_; }
+	T& get() {
+		if (!valid_)
+			throw std::runtime_error("accessing invalid data");
+		return data_;
+	}
+	const T& get() const {
+		if (!valid_)
+			throw std::runtime_error("accessing invalid data");
+		return data_;
+	}
+	// unchecked access
+	T& operator*() { return data_; }
+	const T& operator*() const { return data_; }
+	T* operator->() { return &data_; }
+	const T* operator->() const { return &data_; }
+
+	template <typename U>
+	T value_or(U&& fallback) const& {
+		return valid_ ? data_ : static_cast<T>(std::forward<U>(fallback));
+	}
+	template <typename U>
+	T value_or(U&& fallback) && {
+		return valid_ ? std::move(data_) : static_cast<T>(std::forward<U>(fallback));
+	}
+
+	// f(value) -> optional<U>, skipped when empty
+	template <typename F>
+	auto and_then(F&& f) const& {
+		using R = std::remove_cvref_t<std::invoke_result_t<F, const T&>>;
+		return valid_ ? std::invoke(std::forward<F>(f), data_) : R{};
+	}
+	template <typename F>
+	auto and_then(F&& f) && {
+		using R = std::remove_cvref_t<std::invoke_result_t<F, T&&>>;
+		return valid_ ? std::invoke(std::forward<F>(f), std::move(data_)) : R{};
+	}
+
+	// f(value) -> U, wrapped in optional<U>, skipped when empty
+	template <typename F>
+	auto transform(F&& f) const& {
+		using U = std::remove_cvref_t<std::invoke_result_t<F, const T&>>;
+		return valid_ ? optional<U>(std::invoke(std::forward<F>(f), data_)) : optional<U>{};
+	}
+	template <typename F>
+	auto transform(F&& f) && {
+		using U = std::remove_cvref_t<std::invoke_result_t<F, T&&>>;
+		return valid_ ? optional<U>(std::invoke(std::forward<F>(f), std::move(data_))) : optional<U>{};
+	}
+
+	// f() -> optional<T>, called only when empty
+	template <typename F>
+	optional or_else(F&& f) const& {
+		return valid_ ? *this : std::invoke(std::forward<F>(f));
+	}
+	template <typename F>
+	optional or_else(F&& f) && {
+		return valid_ ? std::move(*this) : std::invoke(std::forward<F>(f));
+	}
+
+	~optional() requires std::is_trivially_destructible_v<T> = default;
+	~optional() requires (!std::is_trivially_destructible_v<T>) {
+		if (valid_)
+			data_.~T();
+	}
+};
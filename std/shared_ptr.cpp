@@ -1,75 +1,10 @@
 #include <atomic>
 #include <iostream>
+#include <thread>
 #include <vector>
 
-template<typename T>
-class shared_ptr {
-private:
-    T* ptr{};  // pointer to the managed object
-    std::atomic<size_t>* count{};  // reference count
+#include "shared_ptr.hpp"
 
-public:
-    // constructor
-    explicit shared_ptr(T* p=nullptr) : ptr(p), count(new std::atomic<size_t>(1)) {}
-    shared_ptr(const T& d): ptr(new T(d)), count(new std::atomic<size_t>(1)) {}
-
-    // copy constructor
-    shared_ptr(const shared_ptr& other) : ptr(other.ptr), count(other.count) {
-        count->fetch_add(1);
-    }
-
-    // copy assignment operator
-    shared_ptr& operator=(const shared_ptr& other) {
-        if (this != &other) {
-            this->~shared_ptr();  // destroy current object
-            ptr = other.ptr;
-            count = other.count;
-            count->fetch_add(1);
-        }
-        return *this;
-    }
-
-    shared_ptr(shared_ptr&& o) noexcept {
-        // no need for self assignment check for constructor, because there is no self yet
-        ptr = o.ptr;
-        count = o.count;
-        o.ptr = nullptr;
-        o.count = nullptr;
-    }
-    shared_ptr& operator=(shared_ptr&& o) noexcept {
-        if (this == &o) {
-            return;
-        }
-        this->~shared_ptr();
-        ptr = o.ptr;
-        count = o.count;
-        o.ptr = nullptr;
-        o.count = nullptr;
-        return *this;
-    }
-
-    // destructor
-    ~shared_ptr() {
-        if (count && count->fetch_sub(1) == 1) {  // check whether count is nullptr first
-            delete ptr;
-            delete count;
-        }
-    }
-
-    // dereference operator
-    T& operator*() const {
-        return *ptr;
-    }
-
-    // member access operator
-    T* operator->() const {
-        return ptr;
-    }
-};
-template<typename T, typename... Args>
-shared_ptr<T> make_shared(Args&&... args) {
-    return shared_ptr<T>(new T(std::forward<Args>(args)...));
-}
 struct Foo {
     void say() const {
         std::cout << "Foo says hi!\n";
@@ -91,5 +26,45 @@ int main() {
     vec.push_back(make_shared<Foo>());
     // vec.push_back(new Foo());
     vec.emplace_back(new Foo());
+
+    weak_ptr<Foo> w = p2;
+    std::cout << "use_count " << w.use_count() << ", locked " << bool(w.lock()) << std::endl;
+    p2.reset();
+    std::cout << "expired " << w.expired() << ", locked " << bool(w.lock()) << std::endl;
+
+    // confined to this thread, so no atomic ref counting
+    auto local = make_shared<Foo, plain_count>();
+    auto local2 = local;
+    std::cout << "local use_count " << local2.use_count() << std::endl;
+
+    shared_pool<Foo> pool;
+    {
+        auto pooled = allocate_shared<Foo>(pool);
+        pooled->say();
+        std::cout << "pool free " << pool.free_size() << " of " << pool.size() << std::endl;
+    }
+    std::cout << "pool free " << pool.free_size() << " of " << pool.size() << std::endl;
+
+    // one writer publishing book snapshots, readers polling them without touching the ref count
+    struct book_snapshot { int version; int best_bid; int best_ask; };
+    atomic_shared_ptr<book_snapshot> book(make_shared<book_snapshot>(0, 99, 101));
+    std::atomic<bool> done{};
+    std::vector<std::thread> readers;
+    std::atomic<int> torn{};
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&]() {
+            while (!done.load(std::memory_order_relaxed)) {
+                auto snap = book.acquire();
+                if (snap->best_ask - snap->best_bid != 2)
+                    torn++;
+            }
+        });
+    }
+    for (int v = 1; v <= 10000; ++v)
+        book.store(make_shared<book_snapshot>(v, 99 + v, 101 + v));
+    done = true;
+    for (auto& t : readers)
+        t.join();
+    std::cout << "latest version " << book.load()->version << ", torn reads " << torn << std::endl;
     return 0;
 }
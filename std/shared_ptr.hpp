@@ -0,0 +1,425 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../obj_pool.hpp"
+
+// reference count policies
+struct atomic_count {
+    using counter = std::atomic<size_t>;
+    static void inc(counter& c) {
+        c.fetch_add(1, std::memory_order_relaxed);  // taking a ref from an existing one needs no ordering
+    }
+    // returns true when the count dropped to zero
+    static bool dec(counter& c) {
+        if (c.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);  // see every write made through other refs before destroying
+            return true;
+        }
+        return false;
+    }
+    static bool inc_if_nonzero(counter& c) {
+        auto n = c.load(std::memory_order_relaxed);
+        while (n != 0) {
+            if (c.compare_exchange_weak(n, n + 1, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+    static size_t load(const counter& c) { return c.load(std::memory_order_relaxed); }
+};
+
+// for objects confined to one thread: plain increments, no locked instructions
+struct plain_count {
+    using counter = size_t;
+    static void inc(counter& c) { ++c; }
+    static bool dec(counter& c) { return --c == 0; }
+    static bool inc_if_nonzero(counter& c) { return c != 0 && ++c; }
+    static size_t load(const counter& c) { return c; }
+};
+
+template<typename Policy>
+struct control_block {
+    typename Policy::counter shared{1};
+    typename Policy::counter weak{1};  // all weak refs, plus one held collectively by the shared refs
+
+    virtual void dispose() noexcept = 0;  // destroy the managed object
+    virtual void destroy() noexcept = 0;  // free the control block
+protected:
+    ~control_block() = default;
+};
+
+// adopts a pointer allocated elsewhere, two allocations
+template<typename T, typename Policy>
+struct ptr_block final : control_block<Policy> {
+    explicit ptr_block(T* p) : ptr(p) {}
+    void dispose() noexcept override { delete ptr; }
+    void destroy() noexcept override { delete this; }
+    T* ptr;
+};
+
+// object and counts in one allocation, used by make_shared
+template<typename T, typename Policy>
+struct inplace_block final : control_block<Policy> {
+    template<typename... Args>
+    explicit inplace_block(Args&&... args) {
+        new (&storage) T(std::forward<Args>(args)...);
+    }
+    T* get() { return std::launder(reinterpret_cast<T*>(&storage)); }
+    void dispose() noexcept override { get()->~T(); }
+    void destroy() noexcept override { delete this; }
+    alignas(T) unsigned char storage[sizeof(T)];  // raw, so the object can die before the block while weak refs remain
+};
+
+template<typename T, typename Policy>
+class shared_pool;
+
+// like inplace_block, but the block comes from a shared_pool, used by allocate_shared
+template<typename T, typename Policy>
+struct pool_block final : control_block<Policy> {
+    template<typename... Args>
+    explicit pool_block(shared_pool<T, Policy>* pool, Args&&... args) : pool(pool) {
+        new (&storage) T(std::forward<Args>(args)...);
+    }
+    T* get() { return std::launder(reinterpret_cast<T*>(&storage)); }
+    void dispose() noexcept override { get()->~T(); }
+    void destroy() noexcept override { pool->release(this); }
+    shared_pool<T, Policy>* pool;
+    alignas(T) unsigned char storage[sizeof(T)];
+};
+
+// the blocks of allocate_shared. obj_pool is not thread-safe and with atomic_count the last ref may drop on
+// any thread, so the pool is locked; with plain_count every ref stays on one thread and the lock compiles away
+template<typename T, typename Policy = atomic_count>
+class shared_pool {
+    struct no_lock {
+        void lock() {}
+        void unlock() {}
+    };
+    using block = pool_block<T, Policy>;
+    // spelled out because obj_pool's default alignment can't be taken from an incomplete type
+    static constexpr size_t align = std::max(alignof(T), alignof(void*));
+    using pool_t = obj_pool<block, align>;
+public:
+    template<typename... Args>
+    block* make(Args&&... args) {
+        std::lock_guard lk(lock_);
+        return pool_.make(this, std::forward<Args>(args)...).release();
+    }
+    void release(block* b) noexcept {
+        std::lock_guard lk(lock_);
+        typename pool_t::unique_ptr(b, typename pool_t::unique_ptr::deleter_type(&pool_));
+    }
+    size_t size() const {
+        std::lock_guard lk(lock_);
+        return pool_.size();
+    }
+    size_t free_size() const {
+        std::lock_guard lk(lock_);
+        return pool_.free_size();
+    }
+private:
+    mutable std::conditional_t<std::is_same_v<Policy, plain_count>, no_lock, std::mutex> lock_;
+    pool_t pool_;
+};
+
+template<typename T, typename Policy>
+class weak_ptr;
+
+template<typename T, typename Policy = atomic_count>
+class shared_ptr {
+private:
+    T* ptr{};  // pointer to the managed object
+    control_block<Policy>* ctrl{};  // reference counts, nullptr for an empty shared_ptr
+
+    shared_ptr(T* p, control_block<Policy>* c) : ptr(p), ctrl(c) {}  // adopts one shared ref
+
+    void release() {
+        if (ctrl && Policy::dec(ctrl->shared)) {  // check whether ctrl is nullptr first
+            ctrl->dispose();
+            if (Policy::dec(ctrl->weak))
+                ctrl->destroy();
+        }
+        ptr = nullptr;
+        ctrl = nullptr;
+    }
+
+    template<typename U, typename P, typename... Args>
+    friend shared_ptr<U, P> make_shared(Args&&... args);
+    template<typename U, typename P, typename... Args>
+    friend shared_ptr<U, P> allocate_shared(shared_pool<U, P>& pool, Args&&... args);
+    friend class weak_ptr<T, Policy>;
+
+public:
+    // constructor, an empty shared_ptr allocates nothing
+    shared_ptr() = default;
+    explicit shared_ptr(T* p) : ptr(p), ctrl(p ? new ptr_block<T, Policy>(p) : nullptr) {}
+    shared_ptr(const T& d) {
+        auto* b = new inplace_block<T, Policy>(d);
+        ptr = b->get();
+        ctrl = b;
+    }
+
+    // copy constructor
+    shared_ptr(const shared_ptr& other) : ptr(other.ptr), ctrl(other.ctrl) {
+        if (ctrl)
+            Policy::inc(ctrl->shared);
+    }
+
+    // copy assignment operator
+    shared_ptr& operator=(const shared_ptr& other) {
+        if (this != &other) {
+            release();  // drop the current object
+            ptr = other.ptr;
+            ctrl = other.ctrl;
+            if (ctrl)
+                Policy::inc(ctrl->shared);
+        }
+        return *this;
+    }
+
+    shared_ptr(shared_ptr&& o) noexcept : ptr(std::exchange(o.ptr, nullptr)), ctrl(std::exchange(o.ctrl, nullptr)) {
+        // no need for self assignment check for constructor, because there is no self yet
+    }
+    shared_ptr& operator=(shared_ptr&& o) noexcept {
+        if (this == &o) {
+            return *this;
+        }
+        release();
+        ptr = std::exchange(o.ptr, nullptr);
+        ctrl = std::exchange(o.ctrl, nullptr);
+        return *this;
+    }
+
+    // destructor
+    ~shared_ptr() {
+        release();
+    }
+
+    void reset() { release(); }
+
+    T* get() const { return ptr; }
+    size_t use_count() const { return ctrl ? Policy::load(ctrl->shared) : 0; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+    // dereference operator
+    T& operator*() const {
+        return *ptr;
+    }
+
+    // member access operator
+    T* operator->() const {
+        return ptr;
+    }
+};
+
+template<typename T, typename Policy = atomic_count>
+class weak_ptr {
+private:
+    T* ptr{};
+    control_block<Policy>* ctrl{};
+
+public:
+    weak_ptr() = default;
+    weak_ptr(const shared_ptr<T, Policy>& s) : ptr(s.ptr), ctrl(s.ctrl) {
+        if (ctrl)
+            Policy::inc(ctrl->weak);
+    }
+    weak_ptr(const weak_ptr& other) : ptr(other.ptr), ctrl(other.ctrl) {
+        if (ctrl)
+            Policy::inc(ctrl->weak);
+    }
+    weak_ptr& operator=(const weak_ptr& other) {
+        weak_ptr tmp(other);
+        std::swap(ptr, tmp.ptr);
+        std::swap(ctrl, tmp.ctrl);
+        return *this;
+    }
+    weak_ptr(weak_ptr&& o) noexcept : ptr(std::exchange(o.ptr, nullptr)), ctrl(std::exchange(o.ctrl, nullptr)) {}
+    weak_ptr& operator=(weak_ptr&& o) noexcept {
+        weak_ptr tmp(std::move(o));
+        std::swap(ptr, tmp.ptr);
+        std::swap(ctrl, tmp.ctrl);
+        return *this;
+    }
+    ~weak_ptr() {
+        if (ctrl && Policy::dec(ctrl->weak))
+            ctrl->destroy();
+    }
+
+    size_t use_count() const { return ctrl ? Policy::load(ctrl->shared) : 0; }
+    bool expired() const { return use_count() == 0; }
+
+    // a shared_ptr to the object, or an empty one if it's already gone
+    shared_ptr<T, Policy> lock() const {
+        if (ctrl && Policy::inc_if_nonzero(ctrl->shared))
+            return shared_ptr<T, Policy>(ptr, ctrl);
+        return {};
+    }
+};
+
+// one allocation for the object and its counts
+template<typename T, typename Policy = atomic_count, typename... Args>
+shared_ptr<T, Policy> make_shared(Args&&... args) {
+    auto* b = new inplace_block<T, Policy>(std::forward<Args>(args)...);
+    return shared_ptr<T, Policy>(b->get(), b);
+}
+
+// like make_shared, but the block is taken from pool, which must outlive every shared and weak ref
+template<typename T, typename Policy = atomic_count, typename... Args>
+shared_ptr<T, Policy> allocate_shared(shared_pool<T, Policy>& pool, Args&&... args) {
+    auto* b = pool.make(std::forward<Args>(args)...);
+    return shared_ptr<T, Policy>(b->get(), b);
+}
+
+// hazard pointer slots shared by every atomic_shared_ptr. a reader announces the node it is about to use
+// in a slot of its own, and writers don't free a retired node while any slot announces it
+class hazard_domain {
+public:
+    static constexpr size_t max_slots = 128;
+
+    struct alignas(64) slot {  // own cache line, readers never write a line another thread touches
+        std::atomic<const void*> ptr{};
+        std::atomic<bool> owned{};
+    };
+
+    static hazard_domain& instance() {
+        static hazard_domain domain;
+        return domain;
+    }
+
+    // a free slot for this thread; slots are cached per thread so this is a vector pop after warm-up
+    slot* acquire() {
+        auto& cache = local();
+        if (!cache.free.empty()) {
+            auto* s = cache.free.back();
+            cache.free.pop_back();
+            return s;
+        }
+        for (auto& s : slots_) {
+            bool expected = false;
+            if (!s.owned.load(std::memory_order_relaxed) && s.owned.compare_exchange_strong(expected, true))
+                return &s;
+        }
+        throw std::runtime_error("out of hazard pointer slots");
+    }
+    void release(slot* s) {
+        s->ptr.store(nullptr, std::memory_order_release);
+        local().free.push_back(s);
+    }
+
+    bool is_protected(const void* p) const {
+        for (auto& s : slots_) {
+            if (s.ptr.load(std::memory_order_seq_cst) == p)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    struct thread_cache {
+        std::vector<slot*> free;
+        ~thread_cache() {
+            for (auto* s : free)
+                s->owned.store(false, std::memory_order_release);  // thread exits, give the slots back
+        }
+    };
+    static thread_cache& local() {
+        static thread_local thread_cache cache;
+        return cache;
+    }
+
+    slot slots_[max_slots];
+};
+
+// publishes immutable snapshots from writers to many readers.
+// load() returns a counted shared_ptr; acquire() is the cheap path for readers polling at high frequency:
+// it only announces the snapshot in a per-thread hazard slot, so readers never touch the reference count
+// or any cache line written by another reader. a store retires the previous snapshot, which is released
+// once no reader announces it any more
+template<typename T>
+class atomic_shared_ptr {
+private:
+    struct node {
+        shared_ptr<T> sp;
+    };
+
+    // announce the current node in s, retrying until it is still current after the announcement
+    node* protect(hazard_domain::slot* s) const {
+        auto* n = head_.load(std::memory_order_acquire);
+        while (true) {
+            s->ptr.store(n, std::memory_order_seq_cst);
+            auto* cur = head_.load(std::memory_order_seq_cst);
+            if (cur == n)
+                return n;
+            n = cur;
+        }
+    }
+
+    void retire(node* n) {
+        std::lock_guard lk(retire_lock_);  // writers only, readers never take it
+        retired_.push_back(n);
+        auto& hd = hazard_domain::instance();
+        std::erase_if(retired_, [&hd](node* r) {
+            if (hd.is_protected(r))
+                return false;
+            delete r;
+            return true;
+        });
+    }
+
+    std::atomic<node*> head_;
+    std::mutex retire_lock_;
+    std::vector<node*> retired_;
+
+public:
+    class guard {
+    public:
+        explicit guard(const atomic_shared_ptr& p) : slot_(hazard_domain::instance().acquire()), node_(p.protect(slot_)) {}
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+        ~guard() { hazard_domain::instance().release(slot_); }
+
+        const T* get() const { return node_->sp.get(); }
+        const T& operator*() const { return *get(); }
+        const T* operator->() const { return get(); }
+        explicit operator bool() const { return get() != nullptr; }
+        // keep the snapshot beyond the guard
+        shared_ptr<T> share() const { return node_->sp; }
+
+    private:
+        hazard_domain::slot* slot_;
+        node* node_;
+    };
+
+    explicit atomic_shared_ptr(shared_ptr<T> sp = {}) : head_(new node{ std::move(sp) }) {}
+    atomic_shared_ptr(const atomic_shared_ptr&) = delete;
+    atomic_shared_ptr& operator=(const atomic_shared_ptr&) = delete;
+    ~atomic_shared_ptr() {  // no reader may be active any more
+        delete head_.load();
+        for (auto* n : retired_)
+            delete n;
+    }
+
+    void store(shared_ptr<T> sp) {
+        auto* old = head_.exchange(new node{ std::move(sp) }, std::memory_order_seq_cst);
+        retire(old);
+    }
+
+    shared_ptr<T> load() const {
+        return guard(*this).share();
+    }
+
+    // no reference count traffic, the snapshot stays alive as long as the guard does
+    guard acquire() const {
+        return guard(*this);
+    }
+};
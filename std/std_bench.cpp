@@ -0,0 +1,261 @@
+// benchmarks the std/ replicas against their std:: counterparts
+//
+//   g++ -std=c++20 -O2 -pthread std_bench.cpp -o std_bench
+//   ./std_bench [iterations] > results.csv
+//
+// every (type, impl, payload, op) row reports the best of a few runs in ns per object, plus the number of
+// heap allocations and bytes per object counted by the replaced global operator new. output is csv
+#include <algorithm>
+#include <any>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "any.hpp"
+#include "function.hpp"
+#include "function_ref.hpp"
+#include "inplace_function.hpp"
+#include "optional.hpp"
+#include "shared_ptr.hpp"
+#include "variant.hpp"
+
+// interposed global allocator, counts every allocation made through operator new
+static size_t g_allocs = 0;
+static size_t g_bytes = 0;
+
+static void* counted_alloc(size_t sz, size_t align = 0) {
+    ++g_allocs;
+    g_bytes += sz;
+    void* p = align > alignof(std::max_align_t) ? std::aligned_alloc(align, (sz + align - 1) / align * align)
+                                                 : std::malloc(sz ? sz : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t sz) { return counted_alloc(sz); }
+void* operator new[](size_t sz) { return counted_alloc(sz); }
+void* operator new(size_t sz, std::align_val_t al) { return counted_alloc(sz, static_cast<size_t>(al)); }
+void* operator new[](size_t sz, std::align_val_t al) { return counted_alloc(sz, static_cast<size_t>(al)); }
+void* operator new(size_t sz, const std::nothrow_t&) noexcept {
+    try { return counted_alloc(sz); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t sz, const std::nothrow_t&) noexcept {
+    try { return counted_alloc(sz); } catch (...) { return nullptr; }
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+// uninitialized storage for n objects, allocated outside the measured regions
+template <typename T>
+class raw_array {
+public:
+    explicit raw_array(size_t n) : mem_(static_cast<T*>(std::aligned_alloc(alignof(T), (n * sizeof(T) + alignof(T) - 1) / alignof(T) * alignof(T)))) {}
+    ~raw_array() { std::free(mem_); }
+    T* operator[](size_t i) { return mem_ + i; }
+private:
+    T* mem_;
+};
+
+struct measurement {
+    double ns{ 1e300 };
+    double allocs{};
+    double bytes{};
+};
+
+template <typename Fn>
+static void measure(measurement& m, size_t n, Fn&& fn) {
+    auto allocs = g_allocs;
+    auto bytes = g_bytes;
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    m.ns = std::min(m.ns, ns / n);
+    m.allocs = double(g_allocs - allocs) / n;
+    m.bytes = double(g_bytes - bytes) / n;
+}
+
+static volatile size_t g_sink;
+
+// construct, copy, move, access and destroy n objects of T, made by make(i) and read by access(obj)
+template <typename T, typename Make, typename Access>
+static void bench(const char* type, const char* impl, const char* payload, size_t n, Make make, Access access) {
+    static constexpr int runs = 5;
+    measurement construct, copy, move, use, destroy;
+    raw_array<T> src(n), dst(n), moved(n);
+    for (int r = 0; r < runs; ++r) {
+        measure(construct, n, [&]() {
+            for (size_t i = 0; i < n; ++i)
+                new (src[i]) T(make(i));
+        });
+        measure(copy, n, [&]() {
+            for (size_t i = 0; i < n; ++i)
+                new (dst[i]) T(*src[i]);
+        });
+        measure(move, n, [&]() {
+            for (size_t i = 0; i < n; ++i)
+                new (moved[i]) T(std::move(*dst[i]));
+        });
+        measure(use, n, [&]() {
+            size_t sum = 0;
+            for (size_t i = 0; i < n; ++i)
+                sum += access(*moved[i]);
+            g_sink = sum;
+        });
+        for (size_t i = 0; i < n; ++i) {
+            dst[i]->~T();
+            moved[i]->~T();
+        }
+        measure(destroy, n, [&]() {
+            for (size_t i = 0; i < n; ++i)
+                src[i]->~T();
+        });
+    }
+    auto row = [&](const char* op, const measurement& m) {
+        std::printf("%s,%s,%s,%s,%.2f,%.3f,%.1f\n", type, impl, payload, op, m.ns, m.allocs, m.bytes);
+    };
+    row("construct", construct);
+    row("copy", copy);
+    row("move", move);
+    row("access", use);
+    row("destroy", destroy);
+}
+
+using big_t = std::array<char, 64>;
+
+static big_t make_big(size_t i) {
+    big_t b{};
+    b[0] = static_cast<char>(i);
+    return b;
+}
+
+// named callables for function_ref, which needs them to outlive the view
+struct adder {
+    size_t i{};
+    size_t operator()(size_t v) const { return v + i; }
+};
+struct big_adder {
+    big_t b{};
+    size_t operator()(size_t v) const { return v + b[0]; }
+};
+
+static std::string make_string(size_t i) {
+    return std::string(64, static_cast<char>('a' + i % 26));
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 100000;
+    std::printf("type,impl,payload,op,ns_per_op,allocs_per_op,bytes_per_op\n");
+
+    // function: a small capture fits the inline buffers of both, a 64 byte capture fits neither
+    bench<function<size_t(size_t)>>("function", "replica", "small", n,
+        [](size_t i) { return function<size_t(size_t)>([i](size_t v) { return v + i; }); },
+        [](const function<size_t(size_t)>& f) { return f(1); });
+    bench<std::function<size_t(size_t)>>("function", "std", "small", n,
+        [](size_t i) { return std::function<size_t(size_t)>([i](size_t v) { return v + i; }); },
+        [](const std::function<size_t(size_t)>& f) { return f(1); });
+    bench<function<size_t(size_t)>>("function", "replica", "large", n,
+        [](size_t i) { return function<size_t(size_t)>([b = make_big(i)](size_t v) { return v + b[0]; }); },
+        [](const function<size_t(size_t)>& f) { return f(1); });
+    bench<std::function<size_t(size_t)>>("function", "std", "large", n,
+        [](size_t i) { return std::function<size_t(size_t)>([b = make_big(i)](size_t v) { return v + b[0]; }); },
+        [](const std::function<size_t(size_t)>& f) { return f(1); });
+
+    // the non-allocating companions on the same payloads. the large inplace_function is sized to hold the 64 byte
+    // capture, function_ref views callables that live in a vector built outside the measured regions
+    using inplace_fn = inplace_function<size_t(size_t)>;
+    using big_inplace_fn = inplace_function<size_t(size_t), sizeof(big_t)>;
+    bench<inplace_fn>("function", "inplace_function", "small", n,
+        [](size_t i) { return inplace_fn([i](size_t v) { return v + i; }); },
+        [](const inplace_fn& f) { return f(1); });
+    bench<big_inplace_fn>("function", "inplace_function", "large", n,
+        [](size_t i) { return big_inplace_fn([b = make_big(i)](size_t v) { return v + b[0]; }); },
+        [](const big_inplace_fn& f) { return f(1); });
+    std::vector<adder> adders(n);
+    std::vector<big_adder> big_adders(n);
+    for (size_t i = 0; i < n; ++i) {
+        adders[i].i = i;
+        big_adders[i].b = make_big(i);
+    }
+    bench<function_ref<size_t(size_t)>>("function", "function_ref", "small", n,
+        [&](size_t i) { return function_ref<size_t(size_t)>(adders[i]); },
+        [](const function_ref<size_t(size_t)>& f) { return f(1); });
+    bench<function_ref<size_t(size_t)>>("function", "function_ref", "large", n,
+        [&](size_t i) { return function_ref<size_t(size_t)>(big_adders[i]); },
+        [](const function_ref<size_t(size_t)>& f) { return f(1); });
+
+    // any
+    bench<any>("any", "replica", "small", n,
+        [](size_t i) { return any(i); },
+        [](const any& a) { return a.as<size_t>(); });
+    bench<std::any>("any", "std", "small", n,
+        [](size_t i) { return std::any(i); },
+        [](const std::any& a) { return std::any_cast<const size_t&>(a); });
+    bench<any>("any", "replica", "large", n,
+        [](size_t i) { return any(make_string(i)); },
+        [](const any& a) { return a.as<std::string>().size(); });
+    bench<std::any>("any", "std", "large", n,
+        [](size_t i) { return std::any(make_string(i)); },
+        [](const std::any& a) { return std::any_cast<const std::string&>(a).size(); });
+
+    // variant
+    using small_var = variant<int, size_t, double>;
+    using small_std_var = std::variant<int, size_t, double>;
+    using large_var = variant<std::string, big_t>;
+    using large_std_var = std::variant<std::string, big_t>;
+    bench<small_var>("variant", "replica", "small", n,
+        [](size_t i) { return small_var(i); },
+        [](small_var& v) { return v.visit([](auto& x) { return static_cast<size_t>(x); }); });
+    bench<small_std_var>("variant", "std", "small", n,
+        [](size_t i) { return small_std_var(i); },
+        [](small_std_var& v) { return std::visit([](auto& x) { return static_cast<size_t>(x); }, v); });
+    bench<large_var>("variant", "replica", "large", n,
+        [](size_t i) { return large_var(make_string(i)); },
+        [](large_var& v) { return v.visit([](auto& x) { return x.size(); }); });
+    bench<large_std_var>("variant", "std", "large", n,
+        [](size_t i) { return large_std_var(make_string(i)); },
+        [](large_std_var& v) { return std::visit([](auto& x) { return x.size(); }, v); });
+
+    // optional
+    bench<optional<size_t>>("optional", "replica", "small", n,
+        [](size_t i) { return optional<size_t>(i); },
+        [](const optional<size_t>& o) { return o.value_or(0); });
+    bench<std::optional<size_t>>("optional", "std", "small", n,
+        [](size_t i) { return std::optional<size_t>(i); },
+        [](const std::optional<size_t>& o) { return o.value_or(0); });
+    bench<optional<std::string>>("optional", "replica", "large", n,
+        [](size_t i) { return optional<std::string>(make_string(i)); },
+        [](const optional<std::string>& o) { return o->size(); });
+    bench<std::optional<std::string>>("optional", "std", "large", n,
+        [](size_t i) { return std::optional<std::string>(make_string(i)); },
+        [](const std::optional<std::string>& o) { return o->size(); });
+
+    // shared_ptr, through make_shared
+    bench<shared_ptr<size_t>>("shared_ptr", "replica", "small", n,
+        [](size_t i) { return ::make_shared<size_t>(i); },
+        [](const shared_ptr<size_t>& p) { return *p; });
+    bench<std::shared_ptr<size_t>>("shared_ptr", "std", "small", n,
+        [](size_t i) { return std::make_shared<size_t>(i); },
+        [](const std::shared_ptr<size_t>& p) { return *p; });
+    bench<shared_ptr<big_t>>("shared_ptr", "replica", "large", n,
+        [](size_t i) { return ::make_shared<big_t>(make_big(i)); },
+        [](const shared_ptr<big_t>& p) { return size_t((*p)[0]); });
+    bench<std::shared_ptr<big_t>>("shared_ptr", "std", "large", n,
+        [](size_t i) { return std::make_shared<big_t>(make_big(i)); },
+        [](const std::shared_ptr<big_t>& p) { return size_t((*p)[0]); });
+    return 0;
+}
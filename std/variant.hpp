@@ -0,0 +1,191 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+
+// traditional, recusive way to deal with variadic template args
+template <size_t s1, size_t... others>
+struct static_max;
+
+template <size_t s>
+struct static_max<s> {
+	static const size_t value = s;
+};
+
+template <size_t s1, size_t s2, size_t... others>
+struct static_max<s1, s2, others...> {
+	static const size_t value = s1 >= s2 ? static_max<s1, others...>::value : static_max<s2, others...>::value;
+};
+
+// C++ 17 folding expression
+template <size_t ... sizes>
+constexpr std::size_t static_max_2() {
+	std:: size_t ret{0};
+	return ((ret = (sizes > ret ? sizes : ret)), ...);
+};
+template <size_t ... sizes>
+constexpr std::size_t static_max_3() {
+	std:: size_t ret{0};
+	return ((ret=std::max( sizes, ret )), ...);
+};
+template <size_t ... sizes>
+constexpr std::size_t static_max_4() {
+	return std::max({sizes...});
+}
+
+template <typename T, typename... Ts>
+constexpr size_t index_of() {
+	size_t i = 0;
+	bool found = ((std::is_same_v<T, Ts> ? true : (++i, false)) || ...);
+	return found ? i : sizeof...(Ts);
+}
+
+template<typename... Ts>
+struct variant {
+	static_assert(sizeof...(Ts) > 0 && sizeof...(Ts) < 255, "variant needs 1 to 254 alternatives");
+private:
+	static const size_t data_size = static_max_4<sizeof(Ts)...>();
+	// static const size_t data_size = static_max<sizeof(Ts)...>::value;
+	static const size_t data_align = static_max<alignof(Ts)...>::value;
+
+	static constexpr bool trivially_copyable = (std::is_trivially_copyable_v<Ts> && ...);
+	static constexpr bool trivially_destructible = (std::is_trivially_destructible_v<Ts> && ...);
+
+	template<typename T>
+	static constexpr uint8_t index_for() {
+		constexpr size_t idx = index_of<T, Ts...>();
+		static_assert(idx < sizeof...(Ts), "T is not an alternative of this variant");
+		return static_cast<uint8_t>(idx);
+	}
+
+	// per-alternative operations, called through tables indexed by the discriminant
+	template<typename T>
+	static void destroy_alt(void* data) {
+		static_cast<T*>(data)->~T();
+	}
+	template<typename T>
+	static void copy_alt(const void* old_v, void* new_v) {  // const is needed, because it's being used by copy ctor, which expect const args
+		new (new_v) T(*static_cast<const T*>(old_v));
+	}
+	template<typename T>
+	static void move_alt(void* old_v, void* new_v) {
+		new (new_v) T(std::move(*static_cast<T*>(old_v)));
+	}
+	static constexpr void (*destroy_table[])(void*) = { &destroy_alt<Ts>... };
+	static constexpr void (*copy_table[])(const void*, void*) = { &copy_alt<Ts>... };
+	static constexpr void (*move_table[])(void*, void*) = { &move_alt<Ts>... };
+
+	void destroy() {
+		if constexpr (!trivially_destructible) {
+			if (type_id != npos)
+				destroy_table[type_id](data);
+		}
+		type_id = npos;
+	}
+
+	alignas(data_align) unsigned char data[data_size];
+	uint8_t type_id;  // index of the active alternative, npos when empty
+public:
+	static constexpr uint8_t npos = 0xff;
+
+	variant() : type_id(npos) {}
+
+	template<typename T, typename = std::enable_if_t<index_of<std::decay_t<T>, Ts...>() < sizeof...(Ts)>>
+	variant(T&& v) : type_id(npos) {
+		set<std::decay_t<T>>(std::forward<T>(v));
+	}
+
+	// trivially copyable alternatives make a trivially copyable variant, which can be memcpy'd through a ring
+	variant(const variant<Ts...>& o) requires trivially_copyable = default;
+	variant(const variant<Ts...>& o) requires (!trivially_copyable) : type_id(npos) {
+		if (o.type_id != npos)
+			copy_table[o.type_id](o.data, data);
+		type_id = o.type_id;
+	}
+
+	variant(variant<Ts...>&& o) requires trivially_copyable = default;
+	variant(variant<Ts...>&& o) requires (!trivially_copyable) : type_id(npos) {
+		if (o.type_id != npos)
+			move_table[o.type_id](o.data, data);
+		type_id = o.type_id;
+	}
+
+	variant<Ts...>& operator=(const variant<Ts...>& o) requires trivially_copyable = default;
+	variant<Ts...>& operator=(const variant<Ts...>& o) requires (!trivially_copyable) {
+		if (this == &o)
+			return *this;
+		destroy();
+		if (o.type_id != npos)
+			copy_table[o.type_id](o.data, data);
+		type_id = o.type_id;
+		return *this;
+	}
+
+	variant<Ts...>& operator=(variant<Ts...>&& o) requires trivially_copyable = default;
+	variant<Ts...>& operator=(variant<Ts...>&& o) requires (!trivially_copyable) {
+		if (this == &o)
+			return *this;
+		destroy();
+		if (o.type_id != npos)
+			move_table[o.type_id](o.data, data);
+		type_id = o.type_id;
+		return *this;
+	}
+
+	template<typename T, typename...Args>
+	T& set(Args&&... args) {
+		destroy();
+		auto* p = new (data) T(std::forward<Args>(args)...);
+		type_id = index_for<T>();
+		return *p;
+	}
+
+	template<typename T>
+	T& get() {
+		if (type_id == index_for<T>())
+			return *std::launder(reinterpret_cast<T*>(data));
+		else
+			throw std::bad_cast();
+	}
+
+	template<typename T>
+	bool is() const {
+		return type_id == index_for<T>();
+	}
+
+	bool valid() const {
+		return type_id != npos;
+	}
+
+	uint8_t index() const {
+		return type_id;
+	}
+
+	// calls f with the active alternative through a table generated at compile time, O(1) in the number of alternatives
+	template<typename F>
+	decltype(auto) visit(F&& f) {
+		using R = std::invoke_result_t<F, first_t&>;
+		static constexpr R (*table[])(F&, void*) = { &visit_alt<Ts, R, F>... };
+		if (type_id == npos)
+			throw std::bad_cast();
+		return table[type_id](f, data);
+	}
+
+	~variant() requires trivially_destructible = default;
+	~variant() requires (!trivially_destructible) {
+		destroy();
+	}
+
+private:
+	using first_t = std::tuple_element_t<0, std::tuple<Ts...>>;
+
+	template<typename T, typename R, typename F>
+	static R visit_alt(F& f, void* data) {
+		return std::invoke(f, *std::launder(static_cast<T*>(data)));
+	}
+};
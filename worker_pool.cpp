@@ -1,143 +1,70 @@
 #include <iostream>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <vector>
-#include <queue>
-#include <unordered_map>
-#include <unordered_set>
-#include <exception>
-#include <ranges>
-#include <chrono>
+#include <string>
 
+#include "worker_pool.hpp"
 
-template<typename Derived, typename Key, typename Update>
-class worker_pool {
-public:
-	worker_pool(size_t num_workers): num_workers_(num_workers) {}
-	~worker_pool() {
-		stop();
-	}
-	void start() {
-		if (!workers_.empty())
-			return;
-
-		for (int i = 0; i < num_workers_; ++i) {
-			workers_.emplace_back(std::make_unique<std::thread>([this]() {do_work(); }));
-		}
+// move-only: the pool moves updates from add_work through merge and process without copying them
+struct update {
+	update(std::string s) : val(std::move(s)) {}
+	update(update&&) = default;
+	update& operator=(update&&) = default;
+	std::string val{};
+	void merge(update u) {
+		val = std::move(u.val);
 	}
-
-	void stop() {
-		if (workers_.empty())
-			return;
-		{
-			std::lock_guard lk(work_lock_);
-			shutdown_ = true;
-		}
-		work_cond_.notify_all();
-		for (auto& t : workers_) {
-			if (t->joinable()) {
-				t->join();
-			}
-		}
-		workers_.clear();
+	// lets emplace_work merge a new value without building an update first
+	void merge(std::string s) {
+		val = std::move(s);
 	}
-	void add_work(Key key, Update update) {
-		std::lock_guard<std::mutex> dirty_map_lg{ dirty_map_lock_ };
-		auto [it, inserted] = dirty_map_.try_emplace(key, update);
-		if (!inserted) {
-			it->second.merge(std::move(update));
-		}
+};
+class demo : public worker_pool<demo, int, update> {
+public:
+	demo(size_t w, worker_options opts = {}) : worker_pool<demo, int, update>(w, std::move(opts)) {}
+	bool should_process(int, const update& u, const std::chrono::system_clock::time_point&) {
+		return !u.val.empty();
 	}
-	size_t process_all() {
-		std::lock_guard<std::mutex> dirty_map_lg{ dirty_map_lock_ };
-		auto cur_ts = std::chrono::system_clock::now();
-		auto num_updates = std::ranges::count_if(dirty_map_, [this, cur_ts](const auto& x) {
-			return impl().should_process(x.first, x.second, cur_ts);
-			});  // pre-check whether we have work to do. if not, we don't need to fetch work_lock and wip_lock.
-		if (!num_updates)
-			return 0;
-		size_t queued_work{};
-		{
-			std::scoped_lock lk(work_lock_, wip_lock_);
-			for (auto it = dirty_map_.begin(); it != dirty_map_.end();) {
-				
-				auto& key = it->first;
-				auto& update = it->second;
-				if (work_in_progress_.contains(key) || !impl().should_process(key, update, cur_ts)) {
-					it++;
-					continue;
-				}
-				auto w = dirty_map_.extract(it++); // we need to increase it before doing the extract, otherwise it will be invalidated
-				work_queue_.emplace(w.key(), w.mapped());
-				work_in_progress_.emplace(key);
-				queued_work++;
-			}
-		}
-		if (queued_work) {
-			work_cond_.notify_all();
-		}
-		return queued_work;
+	void process(int k, update u) {
+		std::cout << u.val << std::endl;
 	}
-private:
-	Derived& impl() { return static_cast<Derived&>(*this); }
-	void do_work() {
-		while (true) {
-			std::unique_lock<std::mutex> lk(work_lock_);
-			work_cond_.wait(lk, [this]() {return shutdown_ || !work_queue_.empty(); });
-			if (shutdown_)
-				break;
-			auto todo = std::move(work_queue_.front());
-			work_queue_.pop();
-			lk.unlock();
+};
 
-			try {
-				impl().process(todo.first, std::move(todo.second));
-				mark_done(todo.first);
-			}
-			catch (const std::exception& e) {
-				std::cout << e.what() << std::endl;
-			}
-		}
-		std::cout << "thread exiting..." << std::endl;
+// coroutine mode: process suspends on file reads instead of blocking a worker
+class file_demo : public worker_pool<file_demo, int, update> {
+public:
+	file_demo(size_t w) : worker_pool<file_demo, int, update>(w) {}
+	bool should_process(int, const update& u, const std::chrono::system_clock::time_point&) {
+		return !u.val.empty();
 	}
-
-	void mark_done(Key key) {
-		std::lock_guard lk(wip_lock_);
-		work_in_progress_.erase(key);
+	pool_task process(int k, update u) {
+		auto content = co_await read_file(u.val);
+		std::cout << k << ": read " << content.size() << " bytes from " << u.val << std::endl;
 	}
-
-	std::unordered_map<Key, Update> dirty_map_;
-	std::mutex dirty_map_lock_;
-
-	std::queue<std::pair<Key, Update>> work_queue_;
-	std::mutex work_lock_;
-
-	std::unordered_set<Key> work_in_progress_;
-	std::mutex wip_lock_;
-
-	size_t num_workers_{};
-	std::vector<std::unique_ptr<std::thread>> workers_;
-
-	std::condition_variable work_cond_;
-	bool shutdown_{};
 };
 
-struct update {
-	update(const std::string& s) : val(s) {}
-	std::string val{};
-	void merge(update u) {
-		val = u.val;
+// two lanes: orders of the risk desk (negative keys) overtake the backlog of analytics keys,
+// and within a lane the update with the earliest due time goes first
+struct timed_update {
+	std::string val;
+	std::chrono::steady_clock::time_point due;
+	void merge(timed_update u) {
+		val = std::move(u.val);
+		due = std::min(due, u.due);
 	}
 };
-class demo : public worker_pool<demo, int, update> {
+class lanes_demo : public worker_pool<lanes_demo, int, timed_update> {
 public:
-	demo(size_t w) : worker_pool<demo, int, update>(w) {}
-	bool should_process(int, update u, const std::chrono::system_clock::time_point& ) {
-		return !u.val.empty();
+	lanes_demo(size_t w, worker_options opts = {}) : worker_pool<lanes_demo, int, timed_update>(w, std::move(opts)) {}
+	bool should_process(int, const timed_update&, const std::chrono::system_clock::time_point&) {
+		return true;
 	}
-	void process(int k, update u) {
-		std::cout << u.val << std::endl;
+	size_t priority(int k, const timed_update&) {
+		return k < 0 ? 0 : 1;
+	}
+	std::chrono::steady_clock::time_point deadline(int, const timed_update& u) {
+		return u.due;
+	}
+	void process(int k, timed_update u) {
+		std::cout << k << ": " << u.val << std::endl;
 	}
 };
 
@@ -148,6 +75,8 @@ int main() {
 		std::cout << "start done" << std::endl;
 		wp.add_work(1, update("a"));
 		wp.add_work(2, update("b"));
+		wp.emplace_work(2, "b2");  // merged into key 2 in place
+		wp.emplace_work(3, "c");   // constructed in place
 		std::cout << "add work done" << std::endl;
 		std::cout << "add " << wp.process_all() << " job to queue" << std::endl;
 		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
@@ -158,7 +87,42 @@ int main() {
 		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 	}
 	std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-	
+
+	// latency-sensitive pool: workers spin before parking and are pinned to cpu 0 and 1
+	demo fast(2, worker_options{ .wait = wait_strategy::backoff, .cpus = {0, 1}, .name = "fast" });
+	fast.start();
+	fast.add_work(1, update("d"));
+	std::cout << "add " << fast.process_all() << " job to queue" << std::endl;
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	fast.stop();
+
+	// bounded pool: at most 2 distinct keys may wait, further keys are dropped
+	demo bounded(1, worker_options{ .max_dirty_keys = 2, .overflow = overflow_policy::reject });
+	bounded.add_work(1, update("e"));
+	bounded.add_work(2, update("f"));
+	std::cout << "add key 3 to full pool: " << bounded.try_add_work(3, update("g")) << std::endl;
+	std::cout << "rejected " << bounded.counters().rejected << " updates" << std::endl;
+
+	file_demo fd(1);
+	fd.start();
+	fd.add_work(1, update(__FILE__));
+	fd.add_work(2, update("/no/such/file"));
+	fd.process_all();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	lanes_demo ld(1, worker_options{ .lanes = 2, .starvation_limit = 4 });
+	auto now = std::chrono::steady_clock::now();
+	for (int k = 1; k <= 8; ++k)
+		ld.add_work(k, timed_update{ "report", now + std::chrono::milliseconds(10 - k) });
+	ld.add_work(-1, timed_update{ "limit check", now + std::chrono::milliseconds(5) });
+	ld.add_work(-2, timed_update{ "margin call", now });
+	ld.process_all();
+	ld.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	std::cout << "served " << ld.stats().starved << " items out of priority order" << std::endl;
+
+	auto st = wp.stats();
+	std::cout << "adds " << st.adds << ", merges " << st.merges << ", p99 latency " << st.latency.percentile_ns(0.99) << "ns" << std::endl;
 
 	return 0;
 }
\ No newline at end of file
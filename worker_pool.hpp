@@ -0,0 +1,804 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <exception>
+#include <ranges>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// hint to the cpu that we are in a spin loop, so the sibling hyper-thread gets the pipeline
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+enum class wait_strategy {
+	block,      // park on the condition variable right away, best for throughput pools
+	busy_spin,  // never park, burns a core per worker but has the lowest wake-up latency
+	backoff,    // spin, then spin with pause, then yield, then park
+};
+
+enum class overflow_policy {
+	block,     // add_work waits until process_all frees a slot
+	reject,    // the update is dropped and add_work returns false
+	coalesce,  // the update is merged into the entry of Derived::overflow_key(key), required for this policy
+};
+
+struct worker_options {
+	wait_strategy wait{ wait_strategy::block };
+	// budgets for wait_strategy::backoff, in loop iterations
+	uint32_t spin_count{ 1000 };
+	uint32_t pause_count{ 10000 };
+	uint32_t yield_count{ 100 };
+	// worker i is pinned to cpus[i % cpus.size()]; empty means no pinning
+	std::vector<int> cpus{};
+	// worker i is named "<name>-<i>" so it shows up in top/perf
+	std::string name{ "worker" };
+	// capacity limits, 0 means unbounded
+	size_t max_dirty_keys{};  // distinct keys waiting in dirty_map_
+	size_t max_queued{};      // items in the lanes, the rest stays in dirty_map_ and keeps coalescing
+	overflow_policy overflow{ overflow_policy::block };  // what to do with a new key when dirty_map_ is full
+	// dispatch lanes, used when Derived has priority(key, update): lane 0 is served first, the result is clamped
+	// to lanes - 1. within a lane items go earliest deadline first if Derived has deadline(key, update), else FIFO
+	size_t lanes{ 1 };
+	// a waiting lane passed over this many times in a row is served next, 0 means strict priority
+	uint32_t starvation_limit{ 64 };
+};
+
+// how often the capacity limits kicked in
+struct overflow_counters {
+	size_t blocked{};    // add_work calls that had to wait for space
+	size_t rejected{};   // updates dropped because the pool was full
+	size_t coalesced{};  // updates merged into an overflow key
+	size_t deferred{};   // process_all calls that left ready work behind because the lanes were full
+};
+
+// log2 buckets of nanoseconds: bucket i counts samples in [2^i, 2^(i+1))
+struct latency_histogram {
+	static constexpr size_t num_buckets = 48;
+	std::array<size_t, num_buckets> buckets{};
+
+	static size_t bucket_of(uint64_t ns) {
+		return std::min<size_t>(std::bit_width(ns | 1) - 1, num_buckets - 1);
+	}
+	size_t count() const {
+		size_t n{};
+		for (auto b : buckets)
+			n += b;
+		return n;
+	}
+	// upper bound of the bucket holding the p-th percentile, p in [0, 1]
+	uint64_t percentile_ns(double p) const {
+		auto total = count();
+		if (!total)
+			return 0;
+		auto rank = static_cast<size_t>(p * (total - 1)) + 1;
+		size_t seen{};
+		for (size_t i = 0; i < num_buckets; ++i) {
+			seen += buckets[i];
+			if (seen >= rank)
+				return (uint64_t{ 2 } << i) - 1;
+		}
+		return ~uint64_t{};
+	}
+};
+
+struct pool_stats {
+	size_t dirty_keys{};   // distinct keys waiting in dirty_map_
+	size_t queue_depth{};  // items in the lanes and tasks waiting to resume
+	std::vector<size_t> lane_depth;  // items per lane
+	size_t in_progress{};  // keys handed to a worker and not yet done
+	size_t adds{};         // add_work calls that inserted a new key
+	size_t merges{};       // add_work calls coalesced into a pending update via merge
+	size_t process_all_calls{};
+	size_t dispatched{};      // items moved to the lanes over all process_all calls
+	size_t starved{};         // items served out of priority order by starvation_limit
+	size_t max_dispatched{};  // most items moved by a single process_all call
+	std::vector<uint64_t> worker_busy_ns;  // time spent in Derived::process, per worker
+	std::vector<size_t> worker_items;      // items processed, per worker
+	latency_histogram latency;  // from the first add_work of a key to the end of its process
+	overflow_counters overflow;
+};
+
+// resumes suspended pool_tasks, implemented by worker_pool
+struct task_executor {
+	// h is the suspended coroutine to resume, root the top-level task frame it runs under
+	virtual void post(std::coroutine_handle<> h, std::coroutine_handle<> root) = 0;
+protected:
+	~task_executor() = default;
+};
+
+// return type of a coroutine Derived::process. the key stays in work_in_progress_ until the task
+// finishes, so updates of the same key are still serialized across suspension points
+class pool_task {
+public:
+	struct promise_type {
+		task_executor* executor{};
+		std::coroutine_handle<> root{};  // destroying it releases every frame of the task
+		std::coroutine_handle<> continuation{};
+		std::exception_ptr error{};
+		bool detached{};
+
+		pool_task get_return_object() { return pool_task{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		auto final_suspend() noexcept {
+			struct final_awaiter {
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+					auto continuation = h.promise().continuation;
+					if (h.promise().detached)
+						h.destroy();
+					return continuation ? continuation : std::noop_coroutine();
+				}
+				void await_resume() noexcept {}
+			};
+			return final_awaiter{};
+		}
+		void return_void() {}
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	pool_task(pool_task&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+	pool_task(const pool_task&) = delete;
+	pool_task& operator=(const pool_task&) = delete;
+	~pool_task() {
+		if (h_)
+			h_.destroy();
+	}
+
+	// co_await on a task runs it right away on the same executor and resumes the awaiter when it finishes
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> awaiter) noexcept {
+		h_.promise().executor = awaiter.promise().executor;
+		h_.promise().root = awaiter.promise().root;
+		h_.promise().continuation = awaiter;
+		return h_;
+	}
+	void await_resume() {
+		if (h_.promise().error)
+			std::rethrow_exception(h_.promise().error);
+	}
+
+	// run a top-level task on ex, the frame destroys itself once it finishes
+	void start(task_executor* ex) && {
+		auto h = std::exchange(h_, {});
+		h.promise().executor = ex;
+		h.promise().root = h;
+		h.promise().detached = true;
+		h.resume();
+	}
+
+private:
+	explicit pool_task(std::coroutine_handle<promise_type> h) : h_(h) {}
+	std::coroutine_handle<promise_type> h_;
+};
+
+// runs blocking calls on a background thread so pool workers never block on them
+class io_offload {
+public:
+	static io_offload& instance() {
+		static io_offload io;
+		return io;
+	}
+	void submit(std::function<void()> job) {
+		{
+			std::lock_guard lk(lock_);
+			jobs_.push_back(std::move(job));
+		}
+		cond_.notify_one();
+	}
+	~io_offload() {
+		{
+			std::lock_guard lk(lock_);
+			shutdown_ = true;
+		}
+		cond_.notify_one();
+		thread_.join();
+	}
+private:
+	io_offload() : thread_([this]() { run(); }) {}
+	void run() {
+		while (true) {
+			std::unique_lock lk(lock_);
+			cond_.wait(lk, [this]() { return shutdown_ || !jobs_.empty(); });
+			if (jobs_.empty())
+				break;
+			auto job = std::move(jobs_.front());
+			jobs_.pop_front();
+			lk.unlock();
+			job();
+		}
+	}
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::deque<std::function<void()>> jobs_;
+	bool shutdown_{};
+	std::thread thread_;
+};
+
+// co_await read_file(path) inside a pool_task reads the whole file on io_offload and
+// resumes the task on a pool worker with the content
+class read_file {
+public:
+	explicit read_file(std::string path) : path_(std::move(path)) {}
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<pool_task::promise_type> h) {
+		io_offload::instance().submit([this, h]() {
+			std::ifstream in(path_, std::ios::in | std::ios::binary);
+			if (in)
+				data_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			else
+				error_ = std::make_exception_ptr(std::runtime_error("cannot open " + path_));
+			auto& p = h.promise();
+			p.executor->post(h, p.root);  // the last access, the pool may be gone once it returns
+		});
+	}
+	std::string await_resume() {
+		if (error_)
+			std::rethrow_exception(error_);
+		return std::move(data_);
+	}
+private:
+	std::string path_;
+	std::string data_;
+	std::exception_ptr error_;
+};
+
+// Hash is used for the per-key maps, for keys without a std::hash specialization
+template<typename Derived, typename Key, typename Update, typename Hash = std::hash<Key>>
+class worker_pool {
+public:
+	worker_pool(size_t num_workers, worker_options opts = {})
+		: num_workers_(num_workers), opts_(std::move(opts)), worker_stats_(std::make_unique<worker_stat[]>(num_workers)) {
+		if (opts_.overflow == overflow_policy::coalesce && !has_overflow_key)
+			throw std::invalid_argument("overflow_policy::coalesce needs Derived::overflow_key(key)");
+		opts_.lanes = std::max<size_t>(opts_.lanes, 1);
+		lanes_.resize(opts_.lanes);
+		passed_over_.resize(opts_.lanes);
+		lane_depth_ = std::make_unique<std::atomic<size_t>[]>(opts_.lanes);
+	}
+	~worker_pool() {
+		stop();
+		// tasks resumed after the workers stopped never finish, release their frames from the top-level one
+		// down; destroying only the resumed handle would leak its callers
+		for (; !resume_queue_.empty(); resume_queue_.pop())
+			resume_queue_.front().root.destroy();
+	}
+	void start() {
+		if (!workers_.empty())
+			return;
+
+		for (size_t i = 0; i < num_workers_; ++i) {
+			workers_.emplace_back(std::make_unique<std::thread>([this, i]() {do_work(i); }));
+		}
+	}
+
+	void stop() {
+		{
+			std::lock_guard lk(work_lock_);
+			shutdown_ = true;
+		}
+		work_cond_.notify_all();
+		{
+			std::lock_guard lk(dirty_map_lock_);  // blocked producers give up, also on a pool that never started
+		}
+		space_cond_.notify_all();
+		if (workers_.empty())
+			return;
+		for (auto& t : workers_) {
+			if (t->joinable()) {
+				t->join();
+			}
+		}
+		workers_.clear();
+		// tasks suspended on io_offload post back to this pool, wait until each one is in resume_queue_
+		std::unique_lock lk(work_lock_);
+		drain_cond_.wait(lk, [this]() { return live_tasks_ == resume_queue_.size(); });
+	}
+	// returns false if the update was dropped because the pool is full or stopping
+	bool add_work(const Key& key, Update update) {
+		return do_add_work(key, opts_.overflow == overflow_policy::block, std::move(update));
+	}
+	// never blocks: if the pool is full and the policy is overflow_policy::block, the update is rejected
+	bool try_add_work(const Key& key, Update update) {
+		return do_add_work(key, false, std::move(update));
+	}
+	// like add_work, but a new key's Update is constructed in place from args, and a pending one takes
+	// them as update.merge(args...) when Update has such an overload, so no temporary Update is built
+	template<typename... Args>
+	bool emplace_work(const Key& key, Args&&... args) {
+		return do_add_work(key, opts_.overflow == overflow_policy::block, std::forward<Args>(args)...);
+	}
+	// lock-free snapshot, each field is read independently so they may be skewed by in-flight work
+	pool_stats stats() const {
+		pool_stats st;
+		st.dirty_keys = dirty_keys_.load(std::memory_order_relaxed);
+		st.queue_depth = queued_.load(std::memory_order_relaxed);
+		st.in_progress = in_progress_.load(std::memory_order_relaxed);
+		st.adds = add_count_.load(std::memory_order_relaxed);
+		st.merges = merge_count_.load(std::memory_order_relaxed);
+		st.process_all_calls = process_all_count_.load(std::memory_order_relaxed);
+		st.dispatched = dispatched_count_.load(std::memory_order_relaxed);
+		st.max_dispatched = max_dispatched_.load(std::memory_order_relaxed);
+		st.starved = starved_count_.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < opts_.lanes; ++i)
+			st.lane_depth.push_back(lane_depth_[i].load(std::memory_order_relaxed));
+		for (size_t i = 0; i < num_workers_; ++i) {
+			auto& ws = worker_stats_[i];
+			st.worker_busy_ns.push_back(ws.busy_ns.load(std::memory_order_relaxed));
+			st.worker_items.push_back(ws.items.load(std::memory_order_relaxed));
+			for (size_t b = 0; b < latency_histogram::num_buckets; ++b)
+				st.latency.buckets[b] += ws.latency[b].load(std::memory_order_relaxed);
+		}
+		st.overflow = counters();
+		return st;
+	}
+	overflow_counters counters() const {
+		return { blocked_count_.load(std::memory_order_relaxed), rejected_count_.load(std::memory_order_relaxed),
+			coalesced_count_.load(std::memory_order_relaxed), deferred_count_.load(std::memory_order_relaxed) };
+	}
+	size_t process_all() {
+		std::lock_guard<std::mutex> dirty_map_lg{ dirty_map_lock_ };
+		process_all_count_.fetch_add(1, std::memory_order_relaxed);
+		auto cur_ts = std::chrono::system_clock::now();
+		auto num_updates = std::ranges::count_if(dirty_map_, [this, cur_ts](const auto& x) {
+			return impl().should_process(x.first, x.second.update, cur_ts);
+			});  // pre-check whether we have work to do. if not, we don't need to fetch work_lock and wip_lock.
+		if (!num_updates)
+			return 0;
+		size_t queued_work{};
+		bool need_notify{};
+		{
+			std::scoped_lock lk(work_lock_, wip_lock_);
+			auto ready = [&](const Key& key, const Update& update) {
+				return !work_in_progress_.contains(key) && impl().should_process(key, update, cur_ts);
+			};
+			if (is_ranked && opts_.max_queued) {
+				// not every ready key fits, so the most urgent ones go first instead of those early in dirty_map_
+				ranked_.clear();
+				for (auto it = dirty_map_.begin(); it != dirty_map_.end(); ++it) {
+					if (ready(it->first, it->second.update))
+						ranked_.push_back({ rank_of(it->first, it->second.update), it });
+				}
+				size_t room = opts_.max_queued > lane_items_ ? opts_.max_queued - lane_items_ : 0;
+				if (ranked_.size() > room) {
+					auto by_rank = [](const ranked_entry& a, const ranked_entry& b) { return a.r < b.r; };
+					std::partial_sort(ranked_.begin(), ranked_.begin() + room, ranked_.end(), by_rank);
+					ranked_.resize(room);
+					deferred_count_.fetch_add(1, std::memory_order_relaxed);
+				}
+				for (auto& e : ranked_)
+					enqueue(e.it, e.r);  // extract leaves the other iterators valid
+				queued_work = ranked_.size();
+			}
+			else {
+				for (auto it = dirty_map_.begin(); it != dirty_map_.end();) {
+					if (opts_.max_queued && lane_items_ >= opts_.max_queued) {
+						deferred_count_.fetch_add(1, std::memory_order_relaxed);
+						break;
+					}
+					if (!ready(it->first, it->second.update)) {
+						it++;
+						continue;
+					}
+					auto cur = it++; // we need to increase it before doing the extract, otherwise it will be invalidated
+					enqueue(cur, rank_of(cur->first, cur->second.update));
+					queued_work++;
+				}
+			}
+			queued_.fetch_add(queued_work, std::memory_order_release);
+			in_progress_.store(work_in_progress_.size(), std::memory_order_relaxed);
+			need_notify = parked_ > 0;  // spinning workers pick the work up without a futex wake
+		}
+		dirty_keys_.store(dirty_map_.size(), std::memory_order_relaxed);
+		dispatched_count_.fetch_add(queued_work, std::memory_order_relaxed);
+		if (queued_work > max_dispatched_.load(std::memory_order_relaxed))
+			max_dispatched_.store(queued_work, std::memory_order_relaxed);  // only process_all writes it, under dirty_map_lock_
+		if (queued_work && need_notify) {
+			work_cond_.notify_all();
+		}
+		if (queued_work && blocked_producers_) {
+			space_cond_.notify_all();
+		}
+		return queued_work;
+	}
+private:
+	Derived& impl() { return static_cast<Derived&>(*this); }
+
+	// an update waiting in dirty_map_ or a lane, with the time its key was first added
+	struct pending {
+		template<typename... Args>
+		explicit pending(std::chrono::steady_clock::time_point t, Args&&... args) : update(std::forward<Args>(args)...), added(t) {}
+		Update update;
+		std::chrono::steady_clock::time_point added;
+	};
+	using dirty_map_t = std::unordered_map<Key, pending, Hash>;
+
+	// optional Derived hooks: priority(key, update) picks the lane, deadline(key, update) orders a lane
+	static constexpr bool has_priority = requires(Derived & d, const Key & k, const Update & u) {
+		{ d.priority(k, u) } -> std::convertible_to<size_t>;
+	};
+	static constexpr bool has_deadline = requires(Derived & d, const Key & k, const Update & u) {
+		{ d.deadline(k, u) } -> std::convertible_to<std::chrono::steady_clock::time_point>;
+	};
+	static constexpr bool is_ranked = has_priority || has_deadline;
+	static constexpr bool has_overflow_key = requires(Derived & d, const Key & k) {
+		{ d.overflow_key(k) } -> std::convertible_to<Key>;
+	};
+
+	// lane first, then deadline; compared as a pair so lower means more urgent
+	using rank = std::pair<size_t, std::chrono::steady_clock::time_point>;
+	rank rank_of(const Key& key, const Update& update) {
+		rank r{};
+		if constexpr (has_priority)
+			r.first = std::min<size_t>(impl().priority(key, update), opts_.lanes - 1);
+		if constexpr (has_deadline)
+			r.second = impl().deadline(key, update);
+		return r;
+	}
+
+	struct queued {
+		Key key;
+		pending p;
+		std::chrono::steady_clock::time_point deadline;
+	};
+	// min-heap on the deadline for the std heap algorithms
+	struct ranked_entry {
+		rank r;
+		typename dirty_map_t::iterator it;
+	};
+	static bool later_deadline(const queued& a, const queued& b) { return a.deadline > b.deadline; }
+
+	// moves a ready key from dirty_map_ to its lane, work_lock_ and wip_lock_ held
+	void enqueue(typename dirty_map_t::iterator it, rank r) {
+		auto w = dirty_map_.extract(it);
+		work_in_progress_.emplace(w.key());
+		auto& lane = lanes_[r.first];
+		lane.push_back({ std::move(w.key()), std::move(w.mapped()), r.second });
+		if constexpr (has_deadline)
+			std::push_heap(lane.begin(), lane.end(), later_deadline);
+		lane_depth_[r.first].fetch_add(1, std::memory_order_relaxed);
+		++lane_items_;
+	}
+
+	// takes the next item off the most urgent non-empty lane, unless a lower lane has been
+	// passed over starvation_limit times. work_lock_ held and lane_items_ > 0
+	queued pop_work() {
+		size_t pick = opts_.lanes;
+		size_t starving = opts_.lanes;
+		for (size_t i = 0; i < opts_.lanes; ++i) {
+			if (lanes_[i].empty())
+				continue;
+			if (pick == opts_.lanes) {
+				pick = i;
+				continue;
+			}
+			if (opts_.starvation_limit && ++passed_over_[i] >= opts_.starvation_limit && starving == opts_.lanes)
+				starving = i;
+		}
+		if (starving != opts_.lanes) {
+			pick = starving;
+			starved_count_.fetch_add(1, std::memory_order_relaxed);
+		}
+		passed_over_[pick] = 0;
+
+		auto& lane = lanes_[pick];
+		std::optional<queued> q;
+		if constexpr (has_deadline) {
+			std::pop_heap(lane.begin(), lane.end(), later_deadline);
+			q.emplace(std::move(lane.back()));
+			lane.pop_back();
+		}
+		else {
+			q.emplace(std::move(lane.front()));
+			lane.pop_front();
+		}
+		lane_depth_[pick].fetch_sub(1, std::memory_order_relaxed);
+		--lane_items_;
+		return std::move(*q);
+	}
+
+	bool dirty_full() const {
+		return opts_.max_dirty_keys && dirty_map_.size() >= opts_.max_dirty_keys;
+	}
+
+	template<typename... Args>
+	static void merge_into(Update& update, Args&&... args) {
+		if constexpr (requires { update.merge(std::forward<Args>(args)...); })
+			update.merge(std::forward<Args>(args)...);
+		else
+			update.merge(Update(std::forward<Args>(args)...));
+	}
+
+	// args are forwarded at most once, every path that uses them returns
+	template<typename... Args>
+	bool do_add_work(const Key& key, bool can_block, Args&&... args) {
+		std::unique_lock<std::mutex> dirty_map_lk{ dirty_map_lock_ };
+		bool waited{};
+		while (true) {
+			if (auto it = dirty_map_.find(key); it != dirty_map_.end()) {
+				merge_into(it->second.update, std::forward<Args>(args)...);
+				merge_count_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			if (!dirty_full()) {
+				dirty_map_.try_emplace(key, std::chrono::steady_clock::now(), std::forward<Args>(args)...);
+				add_count_.fetch_add(1, std::memory_order_relaxed);
+				dirty_keys_.store(dirty_map_.size(), std::memory_order_relaxed);
+				return true;
+			}
+			if (!can_block || shutdown_)
+				break;
+			if (!waited) {
+				waited = true;
+				blocked_count_.fetch_add(1, std::memory_order_relaxed);
+			}
+			++blocked_producers_;
+			space_cond_.wait(dirty_map_lk, [this]() { return shutdown_ || !dirty_full(); });
+			--blocked_producers_;
+		}
+		if constexpr (has_overflow_key) {
+			if (opts_.overflow == overflow_policy::coalesce && !shutdown_) {
+				// may exceed max_dirty_keys by the number of distinct overflow keys
+				Key okey = impl().overflow_key(key);
+				if (auto it = dirty_map_.find(okey); it != dirty_map_.end())
+					merge_into(it->second.update, std::forward<Args>(args)...);
+				else
+					dirty_map_.try_emplace(std::move(okey), std::chrono::steady_clock::now(), std::forward<Args>(args)...);
+				dirty_keys_.store(dirty_map_.size(), std::memory_order_relaxed);
+				coalesced_count_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		rejected_count_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	void setup_thread(size_t idx) {
+#ifdef __linux__
+		if (!opts_.cpus.empty()) {
+			cpu_set_t cpuset;
+			CPU_ZERO(&cpuset);
+			CPU_SET(opts_.cpus[idx % opts_.cpus.size()], &cpuset);
+			if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0)
+				std::cerr << "failed to pin worker " << idx << std::endl;
+		}
+		auto name = opts_.name + "-" + std::to_string(idx);
+		name.resize(std::min<size_t>(name.size(), 15));  // linux limits thread names to 16 bytes including '\0'
+		pthread_setname_np(pthread_self(), name.c_str());
+#endif
+	}
+
+	bool has_work() const {
+		return queued_.load(std::memory_order_acquire) > 0 || shutdown_.load(std::memory_order_relaxed);
+	}
+
+	// wait for work without touching work_lock_, according to the wait strategy
+	void spin_wait() {
+		if (opts_.wait == wait_strategy::busy_spin) {
+			while (!has_work())
+				;
+			return;
+		}
+		for (uint32_t i = 0; i < opts_.spin_count; ++i) {
+			if (has_work())
+				return;
+		}
+		for (uint32_t i = 0; i < opts_.pause_count; ++i) {
+			if (has_work())
+				return;
+			cpu_relax();
+		}
+		for (uint32_t i = 0; i < opts_.yield_count; ++i) {
+			if (has_work())
+				return;
+			std::this_thread::yield();
+		}
+	}
+
+	static constexpr bool is_coroutine =
+		std::is_same_v<decltype(std::declval<Derived&>().process(std::declval<const Key&>(), std::declval<Update>())), pool_task>;
+
+	// wraps a coroutine Derived::process so the key is released only when the whole task is done
+	pool_task run_task(Key key, pending p) {
+		try {
+			co_await impl().process(key, std::move(p.update));
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+		catch (...) {
+			std::cerr << "process threw a non-std exception" << std::endl;
+		}
+		mark_done(key);
+		record_done(p.added);
+		std::lock_guard lk(work_lock_);
+		--live_tasks_;
+		if (shutdown_)
+			drain_cond_.notify_all();
+	}
+
+	// called from io_offload, notifies under the lock so nothing touches the pool after it is released
+	void post(std::coroutine_handle<> h, std::coroutine_handle<> root) {
+		std::lock_guard lk(work_lock_);
+		resume_queue_.push({ h, root });
+		queued_.fetch_add(1, std::memory_order_release);
+		if (parked_ > 0)
+			work_cond_.notify_one();
+		if (shutdown_)
+			drain_cond_.notify_all();
+	}
+
+	struct pool_executor : task_executor {
+		explicit pool_executor(worker_pool* pool) : pool_(pool) {}
+		void post(std::coroutine_handle<> h, std::coroutine_handle<> root) override { pool_->post(h, root); }
+		worker_pool* pool_;
+	};
+
+	void do_work(size_t idx) {
+		setup_thread(idx);
+		current_stat_ = &worker_stats_[idx];
+		while (true) {
+			if (opts_.wait != wait_strategy::block)
+				spin_wait();
+			std::unique_lock<std::mutex> lk(work_lock_);
+			if (!shutdown_ && !lane_items_ && resume_queue_.empty()) {
+				if (opts_.wait == wait_strategy::busy_spin)
+					continue;  // another worker took it, go back to spinning
+				++parked_;
+				work_cond_.wait(lk, [this]() {return shutdown_ || lane_items_ || !resume_queue_.empty(); });
+				--parked_;
+			}
+			if (shutdown_)
+				break;
+			// finish suspended tasks before starting new ones
+			std::coroutine_handle<> resume{};
+			std::optional<queued> todo;
+			if (!resume_queue_.empty()) {
+				resume = resume_queue_.front().h;
+				resume_queue_.pop();
+			}
+			else {
+				todo.emplace(pop_work());
+				if constexpr (is_coroutine)
+					++live_tasks_;
+			}
+			queued_.fetch_sub(1, std::memory_order_relaxed);
+			lk.unlock();
+
+			auto start_ts = std::chrono::steady_clock::now();
+			if (resume) {
+				resume.resume();
+			}
+			else if constexpr (is_coroutine) {
+				run_task(std::move(todo->key), std::move(todo->p)).start(&executor_);
+			}
+			else {
+				try {
+					impl().process(todo->key, std::move(todo->p.update));
+				}
+				catch (const std::exception& e) {
+					std::cerr << e.what() << std::endl;
+				}
+				catch (...) {
+					std::cerr << "process threw a non-std exception" << std::endl;
+				}
+				mark_done(todo->key);
+				record_done(todo->p.added);
+			}
+			record_busy(start_ts, std::chrono::steady_clock::now());
+		}
+		std::cerr << "thread exiting..." << std::endl;
+	}
+
+	void mark_done(Key key) {
+		std::lock_guard lk(wip_lock_);
+		work_in_progress_.erase(key);
+		in_progress_.store(work_in_progress_.size(), std::memory_order_relaxed);
+	}
+
+	// counters owned by a single worker, on their own cache line so workers don't contend
+	struct alignas(64) worker_stat {
+		std::atomic<uint64_t> busy_ns{};
+		std::atomic<size_t> items{};
+		std::array<std::atomic<size_t>, latency_histogram::num_buckets> latency{};
+	};
+
+	// stats of the worker running on this thread; a resumed task may finish on a different worker than it started on.
+	// null outside the pool, e.g. when an awaitable resumes a task inline on its own thread, and such work goes uncounted
+	static inline thread_local worker_stat* current_stat_{};
+
+	// single writer per worker_stat, so a relaxed load/store pair is enough and avoids a locked instruction
+	static void record_busy(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+		if (!current_stat_)
+			return;
+		auto& ws = *current_stat_;
+		auto busy = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		ws.busy_ns.store(ws.busy_ns.load(std::memory_order_relaxed) + busy, std::memory_order_relaxed);
+	}
+	static void record_done(std::chrono::steady_clock::time_point added) {
+		if (!current_stat_)
+			return;
+		auto& ws = *current_stat_;
+		ws.items.store(ws.items.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		auto latency = static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - added).count());
+		auto& bucket = ws.latency[latency_histogram::bucket_of(latency)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	dirty_map_t dirty_map_;
+	std::mutex dirty_map_lock_;
+	std::condition_variable space_cond_;  // signalled when process_all frees dirty_map_ slots
+	size_t blocked_producers_{};  // guarded by dirty_map_lock_
+
+	std::vector<std::deque<queued>> lanes_;  // indexed by priority, guarded by work_lock_ as are passed_over_ and lane_items_
+	std::vector<uint32_t> passed_over_;  // per lane, pops that served a more urgent lane while it waited
+	size_t lane_items_{};
+	std::vector<ranked_entry> ranked_;  // process_all scratch, guarded by dirty_map_lock_
+	std::mutex work_lock_;
+	std::atomic<size_t> queued_{};  // lane_items_ plus resume_queue_.size(), so spinning workers can poll it without the lock
+	std::unique_ptr<std::atomic<size_t>[]> lane_depth_;  // mirrors lanes_[i].size() for stats()
+	std::atomic<size_t> starved_count_{};
+	size_t parked_{};  // number of workers waiting on work_cond_, guarded by work_lock_
+	struct suspended {
+		std::coroutine_handle<> h;
+		std::coroutine_handle<> root;
+	};
+	std::queue<suspended> resume_queue_;  // tasks whose awaited event completed, guarded by work_lock_
+	size_t live_tasks_{};  // coroutine tasks started and not finished, guarded by work_lock_
+	std::condition_variable drain_cond_;  // signalled on post and task end once shutdown_ is set
+	pool_executor executor_{ this };
+
+	std::unordered_set<Key, Hash> work_in_progress_;
+	std::mutex wip_lock_;
+
+	size_t num_workers_{};
+	worker_options opts_;
+	std::vector<std::unique_ptr<std::thread>> workers_;
+
+	std::condition_variable work_cond_;
+	std::atomic<bool> shutdown_{};
+
+	std::atomic<size_t> blocked_count_{};
+	std::atomic<size_t> rejected_count_{};
+	std::atomic<size_t> coalesced_count_{};
+	std::atomic<size_t> deferred_count_{};
+
+	std::unique_ptr<worker_stat[]> worker_stats_;
+	std::atomic<size_t> dirty_keys_{};
+	std::atomic<size_t> in_progress_{};
+	std::atomic<size_t> add_count_{};
+	std::atomic<size_t> merge_count_{};
+	std::atomic<size_t> process_all_count_{};
+	std::atomic<size_t> dispatched_count_{};
+	std::atomic<size_t> max_dispatched_{};
+};
@@ -0,0 +1,189 @@
+// worker_pool benchmark matrix
+//
+//   g++ -std=c++20 -O2 -pthread worker_pool_bench.cpp -o worker_pool_bench
+//   ./worker_pool_bench [name=v1,v2,...]...
+//
+// every parameter takes a comma separated list and the matrix runs their cross product, e.g.
+//   ./worker_pool_bench producers=1,4 workers=2,8 keys=100,100000 strategy=block,backoff
+// parameters:
+//   producers  threads calling add_work
+//   workers    pool worker threads
+//   keys       key cardinality, producers pick keys uniformly from [0, keys)
+//   size       update payload in bytes
+//   burst      updates sent back to back for the same key, controls the merge rate
+//   select     percent of keys should_process accepts before the final drain
+//   ops        add_work calls per producer
+//   work_ns    time spent in process per item
+//   strategy   scheduling strategies to compare side by side: block, backoff, busy_spin
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "worker_pool.hpp"
+
+struct bench_update {
+	explicit bench_update(size_t sz) : payload(sz, 'x') {}
+	std::vector<char> payload;
+	void merge(bench_update u) {
+		payload = std::move(u.payload);
+	}
+};
+
+struct bench_config {
+	size_t producers{};
+	size_t workers{};
+	size_t keys{};
+	size_t size{};
+	size_t burst{};
+	size_t select{};
+	size_t ops{};
+	size_t work_ns{};
+	std::string strategy;
+};
+
+class bench_pool : public worker_pool<bench_pool, uint64_t, bench_update> {
+public:
+	bench_pool(const bench_config& cfg, worker_options opts)
+		: worker_pool<bench_pool, uint64_t, bench_update>(cfg.workers, std::move(opts)), cfg_(cfg) {}
+
+	bool should_process(uint64_t k, const bench_update&, const std::chrono::system_clock::time_point&) {
+		return drain_.load(std::memory_order_relaxed) || k * 2654435761u % 100 < cfg_.select;
+	}
+	void process(uint64_t, bench_update u) {
+		size_t sum{};
+		for (auto c : u.payload)
+			sum += c;
+		sink_.fetch_add(sum, std::memory_order_relaxed);
+		if (cfg_.work_ns) {
+			auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(cfg_.work_ns);
+			while (std::chrono::steady_clock::now() < until)
+				;
+		}
+	}
+	void drain() { drain_ = true; }
+
+private:
+	const bench_config& cfg_;
+	std::atomic<bool> drain_{};
+	std::atomic<size_t> sink_{};
+};
+
+static worker_options options_for(const std::string& strategy) {
+	worker_options opts;
+	opts.name = "bench";
+	if (strategy == "backoff")
+		opts.wait = wait_strategy::backoff;
+	else if (strategy == "busy_spin")
+		opts.wait = wait_strategy::busy_spin;
+	else if (strategy != "block")
+		throw std::runtime_error("unknown strategy: " + strategy);
+	return opts;
+}
+
+static void run(const bench_config& cfg) {
+	bench_pool pool(cfg, options_for(cfg.strategy));
+	pool.start();
+
+	std::atomic<size_t> producers_done{};
+	auto start_ts = std::chrono::steady_clock::now();
+	std::vector<std::thread> producers;
+	for (size_t p = 0; p < cfg.producers; ++p) {
+		producers.emplace_back([&, p]() {
+			std::mt19937_64 rng(p + 1);
+			std::uniform_int_distribution<uint64_t> pick(0, cfg.keys - 1);
+			for (size_t i = 0; i < cfg.ops;) {
+				auto key = pick(rng);
+				for (size_t b = 0; b < cfg.burst && i < cfg.ops; ++b, ++i)
+					pool.add_work(key, bench_update(cfg.size));
+			}
+			producers_done.fetch_add(1);
+		});
+	}
+	// dispatcher: keep calling process_all until producers are done and everything is processed
+	while (true) {
+		bool producing = producers_done.load() < cfg.producers;
+		if (!producing)
+			pool.drain();
+		auto dispatched = pool.process_all();
+		auto st = pool.stats();
+		if (!producing && st.dirty_keys == 0 && st.queue_depth == 0 && st.in_progress == 0)
+			break;
+		if (!dispatched)
+			std::this_thread::yield();
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_ts).count();
+	for (auto& t : producers)
+		t.join();
+	pool.stop();
+
+	auto st = pool.stats();
+	size_t processed{};
+	for (auto n : st.worker_items)
+		processed += n;
+	auto adds = st.adds + st.merges;
+	std::printf("%-10s %9zu %7zu %8zu %6zu %5zu %6zu | %12.0f %12.0f %8.3f %10.1f | %9llu %9llu %9llu\n",
+		cfg.strategy.c_str(), cfg.producers, cfg.workers, cfg.keys, cfg.size, cfg.burst, cfg.select,
+		adds / elapsed, processed / elapsed, adds ? double(st.merges) / adds : 0.,
+		st.process_all_calls ? double(st.dispatched) / st.process_all_calls : 0.,
+		(unsigned long long)st.latency.percentile_ns(0.5), (unsigned long long)st.latency.percentile_ns(0.99),
+		(unsigned long long)st.latency.percentile_ns(0.999));
+}
+
+int main(int argc, char** argv) {
+	std::map<std::string, std::vector<std::string>> params{
+		{ "producers", { "1", "4" } },
+		{ "workers", { "2", "8" } },
+		{ "keys", { "1000", "100000" } },
+		{ "size", { "64" } },
+		{ "burst", { "1", "8" } },
+		{ "select", { "100" } },
+		{ "ops", { "200000" } },
+		{ "work_ns", { "0" } },
+		{ "strategy", { "block", "backoff" } },
+	};
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		auto eq = arg.find('=');
+		if (eq == std::string::npos || !params.contains(arg.substr(0, eq))) {
+			std::cout << "Usage: ./worker_pool_bench [name=v1,v2,...]..., see the top of worker_pool_bench.cpp" << std::endl;
+			return 1;
+		}
+		auto name = arg.substr(0, eq);
+		auto& values = params[name];
+		values.clear();
+		std::stringstream ss(arg.substr(eq + 1));
+		for (std::string v; std::getline(ss, v, ',');) {
+			// keys are picked from [0, keys), which is empty for 0
+			if (name == "keys" && std::stoul(v) == 0) {
+				std::cout << "keys must be at least 1" << std::endl;
+				return 1;
+			}
+			values.push_back(v);
+		}
+	}
+
+	std::printf("%-10s %9s %7s %8s %6s %5s %6s | %12s %12s %8s %10s | %9s %9s %9s\n", "strategy", "producers", "workers",
+		"keys", "size", "burst", "select", "adds/s", "processed/s", "coalesce", "per_pass", "p50_ns", "p99_ns", "p999_ns");
+	// strategies vary fastest so they land on adjacent rows for comparison
+	for (auto& producers : params["producers"])
+	for (auto& workers : params["workers"])
+	for (auto& keys : params["keys"])
+	for (auto& size : params["size"])
+	for (auto& burst : params["burst"])
+	for (auto& select : params["select"])
+	for (auto& ops : params["ops"])
+	for (auto& work_ns : params["work_ns"])
+	for (auto& strategy : params["strategy"]) {
+		bench_config cfg{ std::stoul(producers), std::stoul(workers), std::stoul(keys), std::stoul(size),
+			std::stoul(burst), std::stoul(select), std::stoul(ops), std::stoul(work_ns), strategy };
+		run(cfg);
+	}
+	return 0;
+}